@@ -0,0 +1,901 @@
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "cpp_uriparser.h"
+#include "cpp_uriparser_stream.h"
+
+// Allocation counting: on glibc malloc and friends are replaced for the whole process,
+// which covers both operator new and the allocations made inside liburiparser.
+namespace
+{
+  std::atomic<std::size_t> allocationCount(0);
+}
+
+#if defined(__GLIBC__)
+#define CPP_URIPARSER_BENCH_COUNT_ALLOCS 1
+extern "C"
+{
+  void* __libc_malloc(std::size_t size);
+  void* __libc_calloc(std::size_t count, std::size_t size);
+  void* __libc_realloc(void* ptr, std::size_t size);
+
+  void* malloc(std::size_t size) __THROW
+  {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(std::size_t count, std::size_t size) __THROW
+  {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* ptr, std::size_t size) __THROW
+  {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+  }
+}
+#endif
+
+namespace
+{
+  enum CorpusKind
+  {
+    SHORT_URLS,
+    LONG_PATHS,
+    QUERY_HEAVY,
+    IPV6_HOSTS,
+    PERCENT_ENCODED,
+    AD_TECH, // 50-200 parameters, for query lookups
+    API_PAGING // numeric paging / filter parameters, for typed lookups
+  };
+
+  struct Corpus
+  {
+    std::vector<std::string> urls;
+    std::size_t bytes;
+  };
+
+  // deterministic so runs stay comparable
+  class CorpusRandom
+  {
+  public:
+    explicit CorpusRandom(unsigned int seed) : state_(seed) {}
+
+    unsigned int Next(unsigned int bound)
+    {
+      state_ = state_ * 1103515245u + 12345u;
+      return (state_ >> 8) % bound;
+    }
+
+    std::string Word(unsigned int minLength, unsigned int maxLength)
+    {
+      static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+      std::string word(minLength + Next(maxLength - minLength + 1), 'a');
+      for (auto& ch : word)
+      {
+        ch = alphabet[Next(sizeof(alphabet) - 1)];
+      }
+      return word;
+    }
+
+    std::string Hex16()
+    {
+      static const char hex[] = "0123456789abcdef";
+      std::string quad;
+      for (unsigned int digits = 1 + Next(4); digits > 0; --digits)
+      {
+        quad += hex[Next(16)];
+      }
+      return quad;
+    }
+
+    std::string Escaped(unsigned int length)
+    {
+      static const char hex[] = "0123456789ABCDEF";
+      std::string text;
+      for (unsigned int idx = 0; idx < length; ++idx)
+      {
+        if (Next(3) == 0)
+        {
+          text += Word(1, 3);
+        }
+        else
+        {
+          const unsigned int octet = 0x80 + Next(0x80);
+          text += '%';
+          text += hex[octet >> 4];
+          text += hex[octet & 0xF];
+        }
+      }
+      return text;
+    }
+
+  private:
+    unsigned int state_;
+  };
+
+  std::string MakeUrl(CorpusKind kind, CorpusRandom& random)
+  {
+    std::string url;
+    switch (kind)
+    {
+    case SHORT_URLS:
+      url = (random.Next(2) ? "https://" : "http://") + random.Word(3, 10) + ".com/" + random.Word(0, 8);
+      break;
+    case LONG_PATHS:
+      url = "https://static." + random.Word(4, 10) + ".org";
+      for (unsigned int segments = 12 + random.Next(9); segments > 0; --segments)
+      {
+        url += '/' + random.Word(4, 16);
+      }
+      break;
+    case QUERY_HEAVY:
+      url = "https://shop." + random.Word(4, 10) + ".com/search?q=" + random.Word(3, 12);
+      for (unsigned int params = 10 + random.Next(11); params > 0; --params)
+      {
+        url += '&' + random.Word(2, 8) + '=' + (random.Next(4) ? random.Word(1, 12) : std::string("a+b+c"));
+      }
+      break;
+    case IPV6_HOSTS:
+      url = "http://[2001:db8:" + random.Hex16() + "::8a2e:370:" + random.Hex16()
+        + "]:" + std::to_string(1024 + random.Next(60000)) + '/' + random.Word(3, 10) + "/index.html";
+      break;
+    case PERCENT_ENCODED:
+      url = "https://wiki.example.org/" + random.Escaped(8 + random.Next(16)) + '/' + random.Escaped(4 + random.Next(8))
+        + "?title=" + random.Escaped(6 + random.Next(10)) + "&lang=%D1%80%D1%83";
+      break;
+    case AD_TECH:
+      url = "https://track." + random.Word(4, 10) + ".net/pixel?cb=" + random.Word(8, 8);
+      for (unsigned int params = 50 + random.Next(151); params > 0; --params)
+      {
+        url += '&' + random.Word(2, 10) + '=' + random.Word(0, 16);
+      }
+      break;
+    case API_PAGING:
+      url = "https://api." + random.Word(4, 10) + ".com/v1/items?limit=" + std::to_string(10 + random.Next(90))
+        + "&offset=" + std::to_string(random.Next(100000)) + "&min_price=" + std::to_string(random.Next(500)) + '.'
+        + std::to_string(random.Next(100)) + "&in_stock=" + (random.Next(2) ? "true" : "false")
+        + "&fields=" + random.Word(4, 12) + "%2C" + random.Word(4, 12);
+      break;
+    }
+    return url;
+  }
+
+  const Corpus& GetCorpus(CorpusKind kind)
+  {
+    static std::vector<Corpus> corpora;
+    if (corpora.empty())
+    {
+      for (int corpusKind = SHORT_URLS; corpusKind <= API_PAGING; ++corpusKind)
+      {
+        CorpusRandom random(0x5eed + corpusKind);
+        Corpus corpus;
+        corpus.bytes = 0;
+        for (int idx = 0; idx < 1000; ++idx)
+        {
+          corpus.urls.push_back(MakeUrl(static_cast<CorpusKind>(corpusKind), random));
+          corpus.bytes += corpus.urls.back().size();
+        }
+        corpora.push_back(std::move(corpus));
+      }
+    }
+    return corpora[kind];
+  }
+
+  // reports ns/url (time/url), bytes/sec, urls/sec and allocs/url over the timed loop
+  class PerUrlCounters
+  {
+  public:
+    PerUrlCounters(benchmark::State& state, const Corpus& corpus) :
+      state_(state),
+      corpus_(corpus),
+      allocationsBefore_(allocationCount.load()){}
+
+    ~PerUrlCounters()
+    {
+      const double urls = static_cast<double>(state_.iterations()) * corpus_.urls.size();
+      state_.SetItemsProcessed(static_cast<int64_t>(urls));
+      state_.SetBytesProcessed(static_cast<int64_t>(state_.iterations() * corpus_.bytes));
+      state_.counters["time/url"] = benchmark::Counter(urls, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+#if defined(CPP_URIPARSER_BENCH_COUNT_ALLOCS)
+      state_.counters["allocs/url"] = (allocationCount.load() - allocationsBefore_) / urls;
+#endif
+    }
+
+  private:
+    benchmark::State& state_;
+    const Corpus& corpus_;
+    std::size_t allocationsBefore_;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////////////////////
+  // C api
+
+  void CParseUri(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        UriParserStateA parserState;
+        UriUriA uri;
+        parserState.uri = &uri;
+        benchmark::DoNotOptimize(uriParseUriExA(&parserState, url.data(), url.data() + url.size()));
+        uriFreeUriMembersA(&uri);
+      }
+    }
+  }
+
+  void CDissectQuery(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::vector<UriUriA> uris(corpus.urls.size());
+    for (std::size_t idx = 0; idx < corpus.urls.size(); ++idx)
+    {
+      UriParserStateA parserState;
+      parserState.uri = &uris[idx];
+      uriParseUriExA(&parserState, corpus.urls[idx].data(), corpus.urls[idx].data() + corpus.urls[idx].size());
+    }
+
+    {
+      PerUrlCounters counters(state, corpus);
+      for (auto _ : state)
+      {
+        for (const auto& uri : uris)
+        {
+          UriQueryListA* queryList = nullptr;
+          int itemCount = 0;
+          benchmark::DoNotOptimize(uriDissectQueryMallocExA(&queryList, &itemCount,
+            uri.query.first, uri.query.afterLast, URI_TRUE, URI_BR_DONT_TOUCH));
+          uriFreeQueryListA(queryList);
+        }
+      }
+    }
+
+    for (auto& uri : uris)
+    {
+      uriFreeUriMembersA(&uri);
+    }
+  }
+
+  void CDissectQueryIntoBuffer(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::vector<UriUriA> uris(corpus.urls.size());
+    for (std::size_t idx = 0; idx < corpus.urls.size(); ++idx)
+    {
+      UriParserStateA parserState;
+      parserState.uri = &uris[idx];
+      uriParseUriExA(&parserState, corpus.urls[idx].data(), corpus.urls[idx].data() + corpus.urls[idx].size());
+    }
+
+    {
+      PerUrlCounters counters(state, corpus);
+      for (auto _ : state)
+      {
+        for (const auto& uri : uris)
+        {
+          UriQueryListA* queryList = nullptr;
+          int itemCount = 0;
+          benchmark::DoNotOptimize(uriDissectQueryIntoBufferA(&queryList, &itemCount,
+            uri.query.first, uri.query.afterLast, URI_TRUE, URI_BR_DONT_TOUCH, nullptr, 0, nullptr));
+          uriFreeQueryListBufferA(queryList);
+        }
+      }
+    }
+
+    for (auto& uri : uris)
+    {
+      uriFreeUriMembersA(&uri);
+    }
+  }
+
+  // Whole urls escaped as query values, e.g. for redirect targets
+  void CEscapeUrl(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::size_t longest = 0;
+    for (const auto& url : corpus.urls)
+    {
+      longest = std::max(longest, url.size());
+    }
+    std::vector<char> out(longest * 6 + 1);
+
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        benchmark::DoNotOptimize(uriEscapeExA(url.data(), url.data() + url.size(), out.data(), URI_TRUE, URI_FALSE));
+      }
+    }
+  }
+
+  // every url fed in 8 character chunks
+  void StreamingUnescape(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    uri_parser::StreamingUnescaper unescaper;
+    std::vector<char> buffer(uri_parser::StreamingUnescaper::WorstCaseSize(8));
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        const boost::string_view text(url);
+        for (std::size_t pos = 0; pos < text.size(); pos += 8)
+        {
+          benchmark::DoNotOptimize(unescaper.Feed(text.substr(pos, 8), buffer.data()));
+        }
+        benchmark::DoNotOptimize(unescaper.Finish(buffer.data()));
+      }
+    }
+  }
+
+  void EscapeToString(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        benchmark::DoNotOptimize(uri_parser::Escape(url, true).size());
+      }
+    }
+  }
+
+  void EscapeWithPathProfile(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        benchmark::DoNotOptimize(uri_parser::Escape<uri_parser::PathEscapeProfile>(url).size());
+      }
+    }
+  }
+
+  void CUnescapeInPlace(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::vector<char> scratch;
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        scratch.assign(url.c_str(), url.c_str() + url.size() + 1);
+        benchmark::DoNotOptimize(uriUnescapeInPlaceExA(scratch.data(), URI_TRUE, URI_BR_DONT_TOUCH));
+      }
+    }
+  }
+
+  void CNormalizeSyntax(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        UriParserStateA parserState;
+        UriUriA uri;
+        parserState.uri = &uri;
+        if (uriParseUriExA(&parserState, url.data(), url.data() + url.size()) == URI_SUCCESS)
+        {
+          benchmark::DoNotOptimize(uriNormalizeSyntaxExA(&uri, uriNormalizeSyntaxMaskRequiredA(&uri)));
+        }
+        uriFreeUriMembersA(&uri);
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////
+  // wrapper
+
+  void UriEntryParse(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        uri_parser::UriEntry<const char*> entry(url.data(), url.data() + url.size());
+        benchmark::DoNotOptimize(entry.HostView().data());
+      }
+    }
+  }
+
+  // the UriTypes round trip: entry construction plus one owning accessor
+  void UriEntryHostText(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        uri_parser::UriEntry<const char*> entry(url.data(), url.data() + url.size());
+        benchmark::DoNotOptimize(entry.HostText());
+      }
+    }
+  }
+
+  void ParserParse(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    uri_parser::Parser<const char*> parser;
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        benchmark::DoNotOptimize(parser.parse(url.data(), url.data() + url.size()).HostView().data());
+      }
+    }
+  }
+
+  void UriEntryParseAndQuery(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        uri_parser::UriEntry<const char*> entry(url.data(), url.data() + url.size());
+        benchmark::DoNotOptimize(entry.Query().size());
+      }
+    }
+  }
+
+  void UriEntryUnescape(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::string unescaped;
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        benchmark::DoNotOptimize(uri_parser::UnescapeString(url.c_str(), unescaped));
+      }
+    }
+  }
+
+  void UnescapeIntoBuffer(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    std::vector<char> buffer;
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        buffer.resize(url.size());
+        benchmark::DoNotOptimize(uri_parser::Unescape(url, buffer.data()));
+      }
+    }
+  }
+
+  void UriEntryNormalize(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& url : corpus.urls)
+      {
+        uri_parser::UriEntry<const char*> entry(url.data(), url.data() + url.size());
+        entry.Normalize();
+        benchmark::DoNotOptimize(entry.HostView().data());
+      }
+    }
+  }
+
+  std::vector<uri_parser::UriEntry<const char*>> ParseCorpus(const Corpus& corpus)
+  {
+    std::vector<uri_parser::UriEntry<const char*>> entries;
+    entries.reserve(corpus.urls.size());
+    for (const auto& url : corpus.urls)
+    {
+      entries.emplace_back(url.data(), url.data() + url.size());
+    }
+    return entries;
+  }
+
+  // last segment of every path, the typical routing lookup
+  void PathHeadLastSegment(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        std::string last;
+        auto pathHead = entry.PathHead();
+        for (auto segment = std::begin(pathHead); segment != std::end(pathHead); ++segment)
+        {
+          last = *segment;
+        }
+        benchmark::DoNotOptimize(last.size());
+      }
+    }
+  }
+
+  void PathViewLastSegment(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        boost::string_view last;
+        for (auto segment : entry.Path())
+        {
+          last = segment;
+        }
+        benchmark::DoNotOptimize(last.size());
+      }
+    }
+  }
+
+  void PathSegmentsLastSegment(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto segments = entry.PathSegments();
+        benchmark::DoNotOptimize(segments.empty() ? 0 : segments.back().size());
+      }
+    }
+  }
+
+  // one parameter out of the whole query, worst case: it is not there
+  void QueryItemsFindKey(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto items = entry.QueryItems();
+        benchmark::DoNotOptimize(items.findKey("missing") == items.end());
+      }
+    }
+  }
+
+  // 15 lookups per url out of ad-tech queries, one of them missing. The index
+  // is dropped every round so its build is paid for once per url.
+  struct QueryLookups
+  {
+    std::vector<uri_parser::UriQuery<std::string>> queries;
+    std::vector<std::vector<std::string>> keys;
+  };
+
+  const QueryLookups& GetQueryLookups()
+  {
+    static QueryLookups lookups;
+    if (lookups.queries.empty())
+    {
+      for (const auto& entry : ParseCorpus(GetCorpus(AD_TECH)))
+      {
+        lookups.queries.push_back(entry.Query());
+        const auto& query = lookups.queries.back();
+        std::vector<std::string> keys;
+        for (std::size_t idx = 0; idx < 14; ++idx)
+        {
+          keys.push_back(query[idx * query.size() / 14].key);
+        }
+        keys.push_back("missing");
+        lookups.keys.push_back(std::move(keys));
+      }
+    }
+    return lookups;
+  }
+
+  void QueryScanFindKey(benchmark::State& state, CorpusKind kind)
+  {
+    const QueryLookups& lookups = GetQueryLookups();
+    PerUrlCounters counters(state, GetCorpus(kind));
+    for (auto _ : state)
+    {
+      for (std::size_t idx = 0; idx < lookups.queries.size(); ++idx)
+      {
+        const auto& query = lookups.queries[idx];
+        for (const auto& key : lookups.keys[idx])
+        {
+          // what findKey did before the index: key taken by value, compare() per item
+          const std::string keyStr = key;
+          benchmark::DoNotOptimize(std::find_if(query.begin(), query.end(),
+            [&keyStr](const uri_parser::UriQueryItem<std::string>& item) { return item.key.compare(keyStr) == 0; }));
+        }
+      }
+    }
+  }
+
+  void QueryIndexFindKey(benchmark::State& state, CorpusKind kind)
+  {
+    QueryLookups lookups = GetQueryLookups();
+    PerUrlCounters counters(state, GetCorpus(kind));
+    for (auto _ : state)
+    {
+      for (std::size_t idx = 0; idx < lookups.queries.size(); ++idx)
+      {
+        auto& query = lookups.queries[idx];
+        query.ResetIndex();
+        for (const auto& key : lookups.keys[idx])
+        {
+          benchmark::DoNotOptimize(query.findKey(key));
+        }
+      }
+    }
+  }
+
+  // tracking parameters, mostly missing: one findKey scan per key versus a single ExtractParams scan
+  void QueryItemsFindKeys(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    const char* const keys[] = { "q", "utm_source", "utm_medium", "gclid" };
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto items = entry.QueryItems();
+        for (auto key : keys)
+        {
+          benchmark::DoNotOptimize(items.findKey(key));
+        }
+      }
+    }
+  }
+
+  void ExtractParams(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    const char* const keys[] = { "q", "utm_source", "utm_medium", "gclid" };
+    const uri_parser::QueryParamSet<char, 4> keySet(keys);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        benchmark::DoNotOptimize(uri_parser::ExtractParams(entry, keySet));
+      }
+    }
+  }
+
+  // cache key: drop some parameters, sort the rest by key. UriQuery + C compose versus CanonicalizeQuery
+  void QueryComposeCanonical(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto query = entry.Query();
+        query.erase(std::remove_if(query.begin(), query.end(), [](const uri_parser::UriQueryItem<std::string>& item)
+          { return item.key == "q" || item.key == "utm_source" || item.key == "gclid"; }), query.end());
+        std::stable_sort(query.begin(), query.end(), [](const uri_parser::UriQueryItem<std::string>& lhs,
+          const uri_parser::UriQueryItem<std::string>& rhs) { return lhs.key < rhs.key; });
+        std::vector<UriQueryListA> items(query.size());
+        for (std::size_t idx = 0; idx < items.size(); ++idx)
+        {
+          items[idx].key = query[idx].key.c_str();
+          items[idx].value = query[idx].value.c_str();
+          items[idx].next = idx + 1 < items.size() ? &items[idx + 1] : nullptr;
+        }
+        char* composed = nullptr;
+        uriComposeQueryMallocA(&composed, items.empty() ? nullptr : items.data());
+        benchmark::DoNotOptimize(composed);
+        free(composed);
+      }
+    }
+  }
+
+  void CanonicalizeQuery(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    uri_parser::QueryCanonicalPolicy<char> policy;
+    policy.Deny("q").Deny("utm_source").Deny("gclid");
+    std::string canonical;
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        benchmark::DoNotOptimize(uri_parser::CanonicalizeQuery(entry, policy, canonical).data());
+      }
+    }
+  }
+
+  // typed paging parameters: unescaped strings + stoll/stod versus get<T> on the raw view
+  void QueryStringToNumber(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto query = entry.Query();
+        benchmark::DoNotOptimize(std::stoll(query.findKey("limit")->value));
+        benchmark::DoNotOptimize(std::stoll(query.findKey("offset")->value));
+        benchmark::DoNotOptimize(std::stod(query.findKey("min_price")->value));
+        benchmark::DoNotOptimize(query.findKey("in_stock")->value == "true");
+      }
+    }
+  }
+
+  void QueryTypedGet(benchmark::State& state, CorpusKind kind)
+  {
+    const Corpus& corpus = GetCorpus(kind);
+    auto entries = ParseCorpus(corpus);
+    PerUrlCounters counters(state, corpus);
+    for (auto _ : state)
+    {
+      for (const auto& entry : entries)
+      {
+        auto items = entry.QueryItems();
+        benchmark::DoNotOptimize(items.get<int64_t>("limit"));
+        benchmark::DoNotOptimize(items.get<int64_t>("offset"));
+        benchmark::DoNotOptimize(items.get<double>("min_price"));
+        benchmark::DoNotOptimize(items.get<bool>("in_stock"));
+      }
+    }
+  }
+
+  // outgoing query with 20 pairs: C list + uriComposeQueryMallocA versus QueryBuilder
+  struct OutgoingPairs
+  {
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::size_t bytes;
+  };
+
+  const OutgoingPairs& GetOutgoingPairs()
+  {
+    static OutgoingPairs pairs;
+    if (pairs.keys.empty())
+    {
+      CorpusRandom random(0xb01d);
+      pairs.bytes = 0;
+      for (int idx = 0; idx < 20; ++idx)
+      {
+        pairs.keys.push_back(random.Word(2, 10));
+        pairs.values.push_back(random.Word(0, 12) + (idx % 3 == 0 ? " & more/stuff" : ""));
+        pairs.bytes += pairs.keys.back().size() + pairs.values.back().size();
+      }
+    }
+    return pairs;
+  }
+
+  void ReportOutgoing(benchmark::State& state, const OutgoingPairs& pairs, std::size_t allocationsBefore)
+  {
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * pairs.bytes));
+    state.counters["time/url"] = benchmark::Counter(static_cast<double>(state.iterations()),
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+#if defined(CPP_URIPARSER_BENCH_COUNT_ALLOCS)
+    state.counters["allocs/url"] = static_cast<double>(allocationCount.load() - allocationsBefore) / state.iterations();
+#endif
+  }
+
+  void CComposeQuery(benchmark::State& state)
+  {
+    const OutgoingPairs& pairs = GetOutgoingPairs();
+    const std::size_t allocationsBefore = allocationCount.load();
+    for (auto _ : state)
+    {
+      std::vector<UriQueryListA> items(pairs.keys.size());
+      for (std::size_t idx = 0; idx < items.size(); ++idx)
+      {
+        items[idx].key = pairs.keys[idx].c_str();
+        items[idx].value = pairs.values[idx].c_str();
+        items[idx].next = idx + 1 < items.size() ? &items[idx + 1] : nullptr;
+      }
+      char* query = nullptr;
+      uriComposeQueryMallocA(&query, items.data());
+      benchmark::DoNotOptimize(query);
+      free(query);
+    }
+    ReportOutgoing(state, pairs, allocationsBefore);
+  }
+
+  void QueryBuilderCompose(benchmark::State& state)
+  {
+    const OutgoingPairs& pairs = GetOutgoingPairs();
+    uri_parser::QueryBuilder builder;
+    const std::size_t allocationsBefore = allocationCount.load();
+    for (auto _ : state)
+    {
+      builder.clear();
+      for (std::size_t idx = 0; idx < pairs.keys.size(); ++idx)
+      {
+        builder.Append(pairs.keys[idx], pairs.values[idx]);
+      }
+      benchmark::DoNotOptimize(builder.c_str());
+    }
+    ReportOutgoing(state, pairs, allocationsBefore);
+  }
+} // namespace
+
+#define CPP_URIPARSER_BENCH_ALL_CORPORA(func) \
+  BENCHMARK_CAPTURE(func, short, SHORT_URLS); \
+  BENCHMARK_CAPTURE(func, long_path, LONG_PATHS); \
+  BENCHMARK_CAPTURE(func, query_heavy, QUERY_HEAVY); \
+  BENCHMARK_CAPTURE(func, ipv6, IPV6_HOSTS); \
+  BENCHMARK_CAPTURE(func, percent_encoded, PERCENT_ENCODED)
+
+CPP_URIPARSER_BENCH_ALL_CORPORA(CParseUri);
+CPP_URIPARSER_BENCH_ALL_CORPORA(UriEntryParse);
+CPP_URIPARSER_BENCH_ALL_CORPORA(ParserParse);
+CPP_URIPARSER_BENCH_ALL_CORPORA(CNormalizeSyntax);
+CPP_URIPARSER_BENCH_ALL_CORPORA(UriEntryNormalize);
+CPP_URIPARSER_BENCH_ALL_CORPORA(CUnescapeInPlace);
+CPP_URIPARSER_BENCH_ALL_CORPORA(UriEntryUnescape);
+BENCHMARK_CAPTURE(UriEntryHostText, short, SHORT_URLS);
+BENCHMARK_CAPTURE(PathHeadLastSegment, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(PathViewLastSegment, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(PathSegmentsLastSegment, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(CDissectQuery, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(CDissectQuery, percent_encoded, PERCENT_ENCODED);
+BENCHMARK_CAPTURE(CDissectQueryIntoBuffer, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(CDissectQueryIntoBuffer, percent_encoded, PERCENT_ENCODED);
+BENCHMARK_CAPTURE(CEscapeUrl, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(CEscapeUrl, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(EscapeToString, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(EscapeToString, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(EscapeWithPathProfile, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(UnescapeIntoBuffer, long_path, LONG_PATHS);
+BENCHMARK_CAPTURE(UnescapeIntoBuffer, percent_encoded, PERCENT_ENCODED);
+BENCHMARK_CAPTURE(StreamingUnescape, percent_encoded, PERCENT_ENCODED);
+BENCHMARK_CAPTURE(QueryItemsFindKey, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(QueryItemsFindKey, percent_encoded, PERCENT_ENCODED);
+BENCHMARK_CAPTURE(QueryScanFindKey, ad_tech, AD_TECH);
+BENCHMARK_CAPTURE(QueryIndexFindKey, ad_tech, AD_TECH);
+BENCHMARK_CAPTURE(QueryItemsFindKeys, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(ExtractParams, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(QueryItemsFindKeys, ad_tech, AD_TECH);
+BENCHMARK_CAPTURE(ExtractParams, ad_tech, AD_TECH);
+BENCHMARK_CAPTURE(QueryComposeCanonical, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(CanonicalizeQuery, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(QueryStringToNumber, api_paging, API_PAGING);
+BENCHMARK_CAPTURE(QueryTypedGet, api_paging, API_PAGING);
+BENCHMARK_CAPTURE(UriEntryParseAndQuery, query_heavy, QUERY_HEAVY);
+BENCHMARK_CAPTURE(UriEntryParseAndQuery, percent_encoded, PERCENT_ENCODED);
+
+BENCHMARK(CComposeQuery);
+BENCHMARK(QueryBuilderCompose);
+
+BENCHMARK_MAIN();
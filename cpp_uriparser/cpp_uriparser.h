@@ -5,8 +5,13 @@
 #include <stdexcept>
 #include <iterator>
 #include <vector>
+#include <string>
+#include <type_traits>
 #include <memory>
 #include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
 #include "cpp_uriparser_query.h"
 #include "uriparser/Uri.h"
 
@@ -41,19 +46,20 @@ namespace uri_parser
       return *this;
     }
 
-    IteratorType operator++(int) const
+    IteratorType operator++(int)
     {
       IteratorType tmp(*this);
-      return ++tmp;
+      ++*this;
+      return tmp;
     }
 
-    bool operator==(const IteratorType& right)
+    bool operator==(const IteratorType& right) const
     {
       return ((pathSegment_.text.afterLast == right.pathSegment_.text.afterLast) &&
         (pathSegment_.next == right.pathSegment_.next));
     }
 
-    bool operator!=(const IteratorType& right)
+    bool operator!=(const IteratorType& right) const
     {
       return !operator==(right);
     }
@@ -92,41 +98,245 @@ namespace uri_parser
     UrlReturnType returnObjStorage_;
   };
 
+  // Walks the parsed path segment list handing out views into the url text.
+  // Just a pointer to the current node: trivially copyable, never allocates.
+  template <class UriPathSegmentType, class UrlViewType>
+  class UrlPathViewIterator: public std::iterator<std::forward_iterator_tag, UrlViewType, std::ptrdiff_t, const UrlViewType*, UrlViewType>
+  {
+    typedef UrlPathViewIterator<UriPathSegmentType, UrlViewType> IteratorType;
+  public:
+    // segments are handed out by value, -> needs something to point to
+    struct ArrowProxy
+    {
+      UrlViewType view;
+      const UrlViewType* operator->() const { return &view; }
+    };
+
+    UrlPathViewIterator() = default;
+
+    explicit UrlPathViewIterator(const UriPathSegmentType* segment) :
+      segment_(segment){}
+
+    UrlViewType operator*() const
+    {
+      return internal::GetViewFromUrlPartInternal<decltype(segment_->text), UrlViewType>(segment_->text);
+    }
+
+    ArrowProxy operator->() const { return ArrowProxy{operator*()}; }
+
+    IteratorType& operator++()
+    {
+      segment_ = segment_->next;
+      return *this;
+    }
+
+    IteratorType operator++(int)
+    {
+      IteratorType tmp(*this);
+      segment_ = segment_->next;
+      return tmp;
+    }
+
+    bool operator==(const IteratorType& right) const { return segment_ == right.segment_; }
+    bool operator!=(const IteratorType& right) const { return segment_ != right.segment_; }
+
+  private:
+    const UriPathSegmentType* segment_ = nullptr;
+  };
+
+  // Range over the path segments for range-for, see ParsedUri::Path()
+  template <class UriPathSegmentType, class UrlViewType>
+  class UrlPathRange
+  {
+  public:
+    typedef UrlPathViewIterator<UriPathSegmentType, UrlViewType> const_iterator;
+    typedef const_iterator iterator;
+
+    explicit UrlPathRange(const UriPathSegmentType* head) :
+      head_(head){}
+
+    const_iterator begin() const { return const_iterator(head_); }
+    const_iterator end() const { return const_iterator(); }
+    bool empty() const { return head_ == nullptr; }
+
+  private:
+    const UriPathSegmentType* head_;
+  };
+
+  // Path segments kept as one contiguous array of (offset, length) pairs into a single
+  // block of text. Random access, no pointer chasing; segments are handed out as views.
+  template <class UrlViewType>
+  class UriPathSegments
+  {
+    typedef typename UrlViewType::value_type CharType;
+  public:
+    struct Segment
+    {
+      std::size_t offset;
+      std::size_t length;
+    };
+
+    // segments are handed out by value, -> needs something to point to
+    struct ArrowProxy
+    {
+      UrlViewType view;
+      const UrlViewType* operator->() const { return &view; }
+    };
+
+    class const_iterator: public std::iterator<std::random_access_iterator_tag, UrlViewType, std::ptrdiff_t, ArrowProxy, UrlViewType>
+    {
+    public:
+      const_iterator() :
+        text_(nullptr),
+        segment_(nullptr){}
+
+      const_iterator(const CharType* text, const Segment* segment) :
+        text_(text),
+        segment_(segment){}
+
+      UrlViewType operator*() const { return UrlViewType(text_ + segment_->offset, segment_->length); }
+      ArrowProxy operator->() const { return ArrowProxy{operator*()}; }
+      UrlViewType operator[](std::ptrdiff_t idx) const { return *(*this + idx); }
+
+      const_iterator& operator++() { ++segment_; return *this; }
+      const_iterator operator++(int) { const_iterator tmp(*this); ++segment_; return tmp; }
+      const_iterator& operator--() { --segment_; return *this; }
+      const_iterator operator--(int) { const_iterator tmp(*this); --segment_; return tmp; }
+      const_iterator& operator+=(std::ptrdiff_t count) { segment_ += count; return *this; }
+      const_iterator& operator-=(std::ptrdiff_t count) { segment_ -= count; return *this; }
+      const_iterator operator+(std::ptrdiff_t count) const { return const_iterator(text_, segment_ + count); }
+      const_iterator operator-(std::ptrdiff_t count) const { return const_iterator(text_, segment_ - count); }
+      std::ptrdiff_t operator-(const const_iterator& right) const { return segment_ - right.segment_; }
+
+      bool operator==(const const_iterator& right) const { return segment_ == right.segment_; }
+      bool operator!=(const const_iterator& right) const { return segment_ != right.segment_; }
+      bool operator<(const const_iterator& right) const { return segment_ < right.segment_; }
+      bool operator>(const const_iterator& right) const { return segment_ > right.segment_; }
+      bool operator<=(const const_iterator& right) const { return segment_ <= right.segment_; }
+      bool operator>=(const const_iterator& right) const { return segment_ >= right.segment_; }
+
+    private:
+      const CharType* text_;
+      const Segment* segment_;
+    };
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    UriPathSegments(const CharType* text, const Segment* segments, std::size_t count) :
+      text_(text),
+      segments_(segments),
+      count_(count){}
+
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    UrlViewType operator[](std::size_t idx) const
+    {
+      return UrlViewType(text_ + segments_[idx].offset, segments_[idx].length);
+    }
+
+    UrlViewType front() const { return operator[](0); }
+    UrlViewType back() const { return operator[](count_ - 1); }
+
+    const_iterator begin() const { return const_iterator(text_, segments_); }
+    const_iterator end() const { return const_iterator(text_, segments_ + count_); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+  private:
+    const CharType* text_;
+    const Segment* segments_;
+    std::size_t count_;
+  };
+
+  // Fixed block of memory for UriEntry to take path segments & host data from.
+  // Reset() releases everything parsed with it at once, so it must outlive those entries.
+  template <std::size_t ArenaSize = 1024>
+  class UriParseArena:
+    public UriArena,
+    boost::noncopyable
+  {
+  public:
+    UriParseArena()
+    {
+      buffer = &storage_;
+      size = ArenaSize;
+      used = 0;
+    }
+
+    void Reset()
+    {
+      used = 0;
+    }
+
+  private:
+    typename std::aligned_storage<ArenaSize, std::alignment_of<void*>::value>::type storage_;
+  };
+
   template <class UrlTextType>
-  class UriEntry: boost::noncopyable
+  class Parser;
+
+  template <class UrlTextType>
+  class ParsedBatch;
+
+  // Read-only view of a parsed url. Does not own the parsed members,
+  // see UriEntry & Parser for the owners.
+  template <class UrlTextType>
+  class ParsedUri
   {
+    template <class ParserTextType>
+    friend class Parser;
+    template <class BatchTextType>
+    friend class ParsedBatch;
+  protected:
     typedef internal::UriTypes<UrlTextType> UriApiTypes;
     typedef typename UriApiTypes::UriObjType UriObjType;
     typedef typename UriApiTypes::UrlReturnType UrlReturnType;
     typedef typename UriApiTypes::UriStateType UriStateType;
     typedef typename UriApiTypes::UriQueryListType UriQueryListType;
     typedef typename UriApiTypes::UriPathSegmentType UriPathSegmentType;
+    typedef typename internal::base_type<UrlTextType>::type CharType;
   public:
-    UriEntry(UrlTextType urlText) :
-      freeMemoryOnClose_(true)
+    typedef typename UriApiTypes::UrlViewType UrlViewType;
+    typedef UriPathSegments<UrlViewType> PathSegmentsType;
+    typedef UrlPathRange<UriPathSegmentType, UrlViewType> PathRangeType;
+
+    ParsedUri() :
+      textFirst_(nullptr),
+      textAfterLast_(nullptr),
+      queryBlocks_(nullptr),
+      inlineBlockTaken_(false),
+      flatPathState_(kFlatPathMissing)
     {
-      state_.uri = &uriObj_;
-      if (uriTypes_.parseUri(&state_, urlText) != URI_SUCCESS)
-      {
-        throw std::runtime_error("uriparser: Uri entry creation failed");
-      }
+      memset(&uriObj_, 0, sizeof(uriObj_));
     }
 
-    UriEntry(UriEntry&& right) :
-      state_(std::move(right.state_)),
+    ParsedUri(ParsedUri&& right) :
       uriObj_(std::move(right.uriObj_)),
-      uriTypes_(std::move(right.uriTypes_)),
-      freeMemoryOnClose_(true)
+      textFirst_(right.textFirst_),
+      textAfterLast_(right.textAfterLast_),
+      queryBlocks_(right.queryBlocks_.exchange(nullptr)),
+      inlineBlockTaken_(right.inlineBlockTaken_.exchange(false)),
+      flatPath_(std::move(right.flatPath_)),
+      flatPathText_(std::move(right.flatPathText_)),
+      flatPathState_(right.flatPathState_.load())
     {
-      right.freeMemoryOnClose_ = false;
+      inlineBlock_.separators = right.inlineBlock_.separators;
+      inlineBlock_.query = std::move(right.inlineBlock_.query);
+      inlineBlock_.next = right.inlineBlock_.next;
+      QueryBlock* head = queryBlocks_.load();
+      for (QueryBlock** link = &head; *link != nullptr; link = &(*link)->next)
+      {
+        if (*link == &right.inlineBlock_)
+        {
+          *link = &inlineBlock_;
+        }
+      }
+      queryBlocks_.store(head);
     }
 
-    virtual ~UriEntry()
+    ~ParsedUri()
     {
-      if (freeMemoryOnClose_)
-      {
-        uriTypes_.freeUriMembers(&uriObj_);
-      }
+      FreeQueryBlocks(queryBlocks_.load());
     }
 
     boost::optional<UrlReturnType> Scheme() const
@@ -144,30 +354,290 @@ namespace uri_parser
       return GetStringFromUrlPart(uriObj_.hostText);
     }
 
-    const UriQuery<UrlReturnType>& Query()
+    // Unescaped query items, dissected once and cached. Separators picks other
+    // characters than '&' and '=', e.g. Query<SemicolonQuerySeparators>().
+    // Safe to call from several threads at once: the first caller publishes an
+    // immutable query (index included), readers never take a lock. The result
+    // stays valid until the entry is destroyed, normalized or parsed again.
+    template <class Separators = DefaultQuerySeparators>
+    const UriQuery<UrlReturnType>& Query() const
+    {
+      const unsigned separators = (static_cast<unsigned char>(Separators::kPair) << 8) | static_cast<unsigned char>(Separators::kKeyValue);
+      QueryBlock* head = queryBlocks_.load(std::memory_order_acquire);
+      for (QueryBlock* block = head; block != nullptr; block = block->next)
+      {
+        if (block->separators == separators)
+        {
+          return block->query;
+        }
+      }
+      return PublishQuery(separators, head, static_cast<const Separators*>(nullptr));
+    }
+
+    // Lazy zero-copy alternative to Query(), see UriQueryView.
+    // Follows the lifetime rules of the *View() accessors.
+    template <class Separators = DefaultQuerySeparators>
+    UriQueryView<CharType, Separators> QueryItems(bool plusToSpace = true) const
+    {
+      return UriQueryView<CharType, Separators>(QueryView(), plusToSpace);
+    }
+
+    boost::optional<UrlReturnType> Fragment() const
+    {
+      return GetStringFromUrlPart(uriObj_.fragment);
+    }
+
+    UrlPathIterator<UriPathSegmentType, UrlReturnType> PathHead() const
+    {
+      if (uriObj_.pathHead == nullptr)
+      {
+        return UrlPathIterator<UriPathSegmentType, UrlReturnType>();
+      }
+      return UrlPathIterator<UriPathSegmentType, UrlReturnType>(*uriObj_.pathHead);
+    }
+
+    // for (auto segment : entry.Path()) - segments as views, nothing allocated.
+    // Views follow the lifetime rules of the *View() accessors.
+    PathRangeType Path() const
+    {
+      return PathRangeType(uriObj_.pathHead);
+    }
+
+    // Random access to the path segments, e.g. segments[segments.size() - 2] or
+    // rbegin()/rend() for routing from the end. Built on the first call from the
+    // parsed list, the views follow the lifetime rules of the *View() accessors.
+    // Safe to call from several threads at once like Query(): one caller builds,
+    // concurrent ones wait for it, later ones only read.
+    PathSegmentsType PathSegments() const
+    {
+      if (flatPathState_.load(std::memory_order_acquire) != kFlatPathBuilt)
+      {
+        PublishFlatPath();
+      }
+      return PathSegmentsType(uriObj_.owner ? flatPathText_.data() : textFirst_, flatPath_.data(), flatPath_.size());
+    }
+
+    // *View() accessors point straight into the parsed text, nothing is copied.
+    // They stay valid as long as the source text is alive and the entry is not
+    // normalized (UriEntry), or until the next parse() (Parser).
+    // Absent components give a view with data() == nullptr, present but empty
+    // ones (e.g. "http://host/?") an empty view with non-null data().
+    UrlViewType SchemeView() const
+    {
+      return GetViewFromUrlPart(uriObj_.scheme);
+    }
+
+    UrlViewType UserInfoView() const
+    {
+      return GetViewFromUrlPart(uriObj_.userInfo);
+    }
+
+    UrlViewType HostView() const
+    {
+      return GetViewFromUrlPart(uriObj_.hostText);
+    }
+
+    UrlViewType PortView() const
+    {
+      return GetViewFromUrlPart(uriObj_.portText);
+    }
+
+    // Raw path including its leading '/'. Not available once Normalize()
+    // made the entry own its members.
+    UrlViewType PathView() const
+    {
+      if (uriObj_.owner)
+      {
+        return UrlViewType();
+      }
+
+      const bool leadingSlash = uriObj_.absolutePath || (uriObj_.hostText.first != nullptr);
+      std::size_t length = leadingSlash ? 1 : 0;
+
+      if (uriObj_.pathHead == nullptr)
+      {
+        if (!uriObj_.absolutePath)
+        {
+          return UrlViewType();
+        }
+      }
+      else
+      {
+        // segments are joined by '/', empty ones may point outside the text
+        for (auto segment = uriObj_.pathHead; segment != nullptr; segment = segment->next)
+        {
+          length += (segment->text.afterLast - segment->text.first) + 1;
+        }
+        length -= 1;
+      }
+
+      const CharType* afterPath =
+        uriObj_.query.first != nullptr ? uriObj_.query.first - 1
+        : uriObj_.fragment.first != nullptr ? uriObj_.fragment.first - 1
+        : textAfterLast_;
+      return UrlViewType(afterPath - length, length);
+    }
+
+    UrlViewType QueryView() const
     {
-      if (lazy_query_.is_initialized())
+      return GetViewFromUrlPart(uriObj_.query);
+    }
+
+    UrlViewType FragmentView() const
+    {
+      return GetViewFromUrlPart(uriObj_.fragment);
+    }
+
+    boost::optional<UrlReturnType> GetUnescapedFragment(
+      bool plusToSpace = true
+      , UriBreakConversion breakConversion = URI_BR_DONT_TOUCH) const
+    {
+      UrlReturnType retVal;
+      return UnescapeString(FragmentView(), retVal, plusToSpace, breakConversion)
+        ? boost::optional<UrlReturnType>(std::move(retVal))
+        : boost::optional<UrlReturnType>();
+    }
+
+    UrlReturnType GetUnescapedUrlString(bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH) const
+    {
+      if (textFirst_ == nullptr)
       {
-        return lazy_query_.get();
+        return UrlReturnType();
       }
+
+      // the text does not have to be NUL-terminated
+      UrlReturnType reslt;
+      return UnescapeString(UrlViewType(textFirst_, textAfterLast_ - textFirst_), reslt, plusToSpace, breakConversion) ? reslt : UrlReturnType();
+    }
+
+  protected:
+    template <class UriTextRangeType>
+    boost::optional<UrlReturnType> GetStringFromUrlPart(UriTextRangeType range) const
+    {
+      auto retVal = internal::GetStringFromUrlPartInternal<UriTextRangeType, UrlReturnType>(range);
+      if (!retVal.empty())
+      {
+        return boost::optional<UrlReturnType>(retVal);
+      }
+      return boost::optional<UrlReturnType>();
+    }
+
+    template <class UriTextRangeType>
+    UrlViewType GetViewFromUrlPart(const UriTextRangeType& range) const
+    {
+      return internal::GetViewFromUrlPartInternal<UriTextRangeType, UrlViewType>(range);
+    }
+
+    // Moves every range pointing into [oldFirst, oldAfterLast] over to the same offset from newFirst
+    void RebaseText(const CharType* oldFirst, const CharType* oldAfterLast, const CharType* newFirst)
+    {
+      auto rebase = [&](const CharType*& ptr)
+      {
+        if (ptr != nullptr && ptr >= oldFirst && ptr <= oldAfterLast)
+        {
+          ptr = newFirst + (ptr - oldFirst);
+        }
+      };
+      auto rebaseRange = [&](decltype(uriObj_.scheme)& range)
+      {
+        rebase(range.first);
+        rebase(range.afterLast);
+      };
+
+      rebaseRange(uriObj_.scheme);
+      rebaseRange(uriObj_.userInfo);
+      rebaseRange(uriObj_.hostText);
+      rebaseRange(uriObj_.hostData.ipFuture);
+      rebaseRange(uriObj_.portText);
+      rebaseRange(uriObj_.query);
+      rebaseRange(uriObj_.fragment);
+      for (auto segment = uriObj_.pathHead; segment != nullptr; segment = segment->next)
+      {
+        rebaseRange(segment->text);
+      }
+      rebase(textFirst_);
+      rebase(textAfterLast_);
+    }
+
+    // No reader may be left here
+    void ResetLazyParts()
+    {
+      FreeQueryBlocks(queryBlocks_.exchange(nullptr));
+      inlineBlockTaken_.store(false);
+      flatPathState_.store(kFlatPathMissing);
+    }
+
+    void PublishFlatPath() const
+    {
+      int state = kFlatPathMissing;
+      if (flatPathState_.compare_exchange_strong(state, kFlatPathBuilding, std::memory_order_acquire))
+      {
+        BuildFlatPath();
+        flatPathState_.store(kFlatPathBuilt, std::memory_order_release);
+        return;
+      }
+      // building a path takes a few pushes, waiting beats a second copy
+      while (flatPathState_.load(std::memory_order_acquire) != kFlatPathBuilt)
+      {
+        std::this_thread::yield();
+      }
+    }
+
+    // Offsets are kept relative to the parsed text so they survive RebaseText.
+    // Normalized entries own their segments, those are gathered into flatPathText_
+    void BuildFlatPath() const
+    {
+      typedef typename PathSegmentsType::Segment Segment;
+      flatPath_.clear();
+      flatPathText_.clear();
+      for (auto segment = uriObj_.pathHead; segment != nullptr; segment = segment->next)
+      {
+        const std::size_t length = segment->text.afterLast - segment->text.first;
+        Segment flat = {0, length};
+        if (length != 0) // empty segments may point outside the text
+        {
+          if (uriObj_.owner)
+          {
+            flat.offset = flatPathText_.size();
+            flatPathText_.append(segment->text.first, segment->text.afterLast);
+          }
+          else
+          {
+            flat.offset = segment->text.first - textFirst_;
+          }
+        }
+        flatPath_.push_back(flat);
+      }
+    }
+
+    // '&' and '=': the whole C list is built in one block, most queries fit on the stack
+    bool DissectQuery(UriQuery<UrlReturnType>& query, const DefaultQuerySeparators*) const
+    {
       int itemCount;
       UriQueryListType* queryList_;
 
-      if (uriTypes_.uriDissectQueryMalloc(&queryList_, &itemCount, uriObj_.query.first, uriObj_.query.afterLast) != 0)
+      void* stackBuffer[128];
+      bool heapBuffer = false;
+      int result = UriApiTypes::uriDissectQueryIntoBuffer(&queryList_, &itemCount, uriObj_.query.first, uriObj_.query.afterLast,
+        stackBuffer, sizeof(stackBuffer), nullptr);
+      if (result == URI_ERROR_OUTPUT_TOO_LARGE)
       {
-        static const UriQuery<UrlReturnType> empty;
-        return empty;
+        heapBuffer = true;
+        result = UriApiTypes::uriDissectQueryIntoBuffer(&queryList_, &itemCount, uriObj_.query.first, uriObj_.query.afterLast,
+          nullptr, 0, nullptr);
+      }
+
+      if (result != 0)
+      {
+        return false;
       }
 
       UriQueryListType* curQuery{queryList_};
       UriQueryItem<UrlReturnType> keyValue;
 
-      // initializing query object once for the first time
-      lazy_query_ = UriQuery<UrlReturnType>();
-
       if (itemCount > 0)
       {
-        lazy_query_->reserve(itemCount);
+        query.reserve(itemCount);
       }
 
       for (auto itemIdx = 0; itemIdx < itemCount; ++itemIdx)
@@ -183,78 +653,288 @@ namespace uri_parser
           keyValue.value = curQuery->value;
         }
 
-        lazy_query_->push_back(std::move(keyValue));
+        query.push_back(std::move(keyValue));
         curQuery = curQuery->next;
       }
 
-      if (queryList_ != nullptr)
+      if (heapBuffer && queryList_ != nullptr)
       {
-        uriTypes_.uriFreeQueryList(queryList_);
+        UriApiTypes::uriFreeQueryListBuffer(queryList_);
       }
+      return true;
+    }
 
-      return lazy_query_.get();
+    // other separators than the C library knows: split by UriQueryView,
+    // unescaped the same way
+    template <class Separators>
+    bool DissectQuery(UriQuery<UrlReturnType>& query, const Separators*) const
+    {
+      UriQueryItem<UrlReturnType> keyValue;
+      for (const auto& item : QueryItems<Separators>())
+      {
+        keyValue.key = item.UnescapedKey();
+        keyValue.value = item.UnescapedValue();
+        query.push_back(std::move(keyValue));
+      }
+      return true;
     }
 
-    boost::optional<UrlReturnType> Fragment() const
+    // Dissected queries are pushed onto queryBlocks_ and not touched afterwards,
+    // one block per separator pair asked for. The first one comes without an
+    // allocation: whoever takes inlineBlock_ fills it, concurrent callers
+    // build their own block.
+    struct QueryBlock
     {
-      return GetStringFromUrlPart(uriObj_.fragment);
+      QueryBlock() :
+        separators(0),
+        next(nullptr){}
+
+      unsigned separators;
+      UriQuery<UrlReturnType> query;
+      QueryBlock* next;
+    };
+
+    template <class Separators>
+    const UriQuery<UrlReturnType>& PublishQuery(unsigned separators, QueryBlock* head, const Separators* tag) const
+    {
+      std::unique_ptr<QueryBlock> heapBlock;
+      QueryBlock* block = &inlineBlock_;
+      if (inlineBlockTaken_.exchange(true, std::memory_order_acquire))
+      {
+        heapBlock.reset(new QueryBlock());
+        block = heapBlock.get();
+      }
+      // clear() keeps the capacity left from the previous parse
+      block->separators = separators;
+      block->query.clear();
+      if (!DissectQuery(block->query, tag))
+      {
+        block->query.clear();
+      }
+      block->query.PrepareIndex();
+
+      // another thread may have published the same separators meanwhile, its
+      // block wins then; blocks below block->next were checked already
+      for (;;)
+      {
+        block->next = head;
+        if (queryBlocks_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_acquire))
+        {
+          heapBlock.release();
+          return block->query;
+        }
+        for (QueryBlock* other = head; other != block->next; other = other->next)
+        {
+          if (other->separators == separators)
+          {
+            return other->query;
+          }
+        }
+      }
     }
 
-    UrlPathIterator<UriPathSegmentType, UrlReturnType> PathHead() const
+    void FreeQueryBlocks(QueryBlock* blocks) const
     {
-      if (uriObj_.pathHead == nullptr)
+      while (blocks != nullptr)
       {
-        return UrlPathIterator<UriPathSegmentType, UrlReturnType>();
+        QueryBlock* next = blocks->next;
+        if (blocks != &inlineBlock_)
+        {
+          delete blocks;
+        }
+        blocks = next;
       }
-      return UrlPathIterator<UriPathSegmentType, UrlReturnType>(*uriObj_.pathHead);
     }
 
-    void Normalize()
+    UriObjType uriObj_;
+    const CharType* textFirst_;
+    const CharType* textAfterLast_;
+    mutable std::atomic<QueryBlock*> queryBlocks_;
+    mutable QueryBlock inlineBlock_;
+    mutable std::atomic<bool> inlineBlockTaken_;
+    mutable std::vector<typename PathSegmentsType::Segment> flatPath_;
+    mutable UrlReturnType flatPathText_;
+    enum { kFlatPathMissing, kFlatPathBuilding, kFlatPathBuilt };
+    mutable std::atomic<int> flatPathState_;
+  };
+
+  template <class UrlTextType>
+  class UriEntry:
+    public ParsedUri<UrlTextType>,
+    boost::noncopyable
+  {
+    typedef typename ParsedUri<UrlTextType>::UriApiTypes UriApiTypes;
+    typedef typename ParsedUri<UrlTextType>::UriStateType UriStateType;
+    typedef typename ParsedUri<UrlTextType>::CharType CharType;
+  public:
+    typedef typename ParsedUri<UrlTextType>::UrlViewType UrlViewType;
+    typedef typename ParsedUri<UrlTextType>::UrlReturnType UrlReturnType;
+
+    UriEntry(UrlTextType urlText) :
+      freeMemoryOnClose_(true)
     {
-      uriTypes_.uriNormalizeSyntax(&uriObj_);
+      Parse(urlText, urlText + std::char_traits<CharType>::length(urlText));
     }
 
-    boost::optional<UrlReturnType> GetUnescapedFragment(
-      bool plusToSpace = true
-      , UriBreakConversion breakConversion = URI_BR_DONT_TOUCH) const
+    // Text does not have to be NUL-terminated, it is not copied
+    UriEntry(UrlTextType first, UrlTextType afterLast) :
+      freeMemoryOnClose_(true)
     {
-      auto frag = GetStringFromUrlPart(uriObj_.fragment);
-      if (!frag.is_initialized())
+      Parse(first, afterLast);
+    }
+
+    // Copies the text once if copyText is set, otherwise it has to outlive the entry
+    UriEntry(UrlViewType urlText, bool copyText = false) :
+      freeMemoryOnClose_(true)
+    {
+      if (copyText)
+      {
+        const CharType* ownText = text_.Assign(urlText.data(), urlText.data() + urlText.size());
+        Parse(ownText, ownText + text_.size());
+      }
+      else
       {
-        return frag;
+        Parse(urlText.data(), urlText.data() + urlText.size());
       }
+    }
 
-      UrlReturnType retVal;
-      return UnescapeString(frag.get().c_str(), retVal, plusToSpace, breakConversion)
-        ? boost::optional<UrlReturnType>(retVal)
-        : boost::optional<UrlReturnType>();
+    // Takes over the text; short urls are kept inline, long ones keep the string's buffer
+    UriEntry(UrlReturnType&& urlText) :
+      freeMemoryOnClose_(true)
+    {
+      const CharType* ownText = text_.Assign(std::move(urlText));
+      Parse(ownText, ownText + text_.size());
     }
 
-    UrlReturnType GetUnescapedUrlString(bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH) const
+    UriEntry(UrlTextType urlText, UriArena& arena) :
+      freeMemoryOnClose_(true)
     {
-      UrlReturnType reslt;
-      return UnescapeString(uriObj_.scheme.first, reslt, plusToSpace, breakConversion) ? reslt : UrlReturnType();
+      state_.uri = &this->uriObj_;
+      this->textFirst_ = urlText;
+      this->textAfterLast_ = urlText + std::char_traits<CharType>::length(urlText);
+      if (UriApiTypes::parseUriExArena(&state_, urlText, this->textAfterLast_, &arena) != URI_SUCCESS)
+      {
+        throw std::runtime_error("uriparser: Uri entry creation failed");
+      }
+    }
+
+    UriEntry(UriEntry&& right) :
+      ParsedUri<UrlTextType>(std::move(right)),
+      state_(std::move(right.state_)),
+      freeMemoryOnClose_(true)
+    {
+      right.freeMemoryOnClose_ = false;
+
+      // owned text might have been moved to another place (inline storage)
+      const CharType* oldText = right.text_.data();
+      const std::size_t oldSize = right.text_.size();
+      text_ = std::move(right.text_);
+      if (oldSize != 0 && oldText != text_.data())
+      {
+        this->RebaseText(oldText, oldText + oldSize, text_.data());
+      }
+    }
+
+    virtual ~UriEntry()
+    {
+      if (freeMemoryOnClose_)
+      {
+        UriApiTypes::freeUriMembers(&this->uriObj_);
+      }
+    }
+
+    void Normalize()
+    {
+      UriApiTypes::uriNormalizeSyntax(&this->uriObj_);
+      this->ResetLazyParts();
     }
 
   private:
-    template <class UriTextRangeType>
-    boost::optional<UrlReturnType> GetStringFromUrlPart(UriTextRangeType range) const
+    void Parse(const CharType* first, const CharType* afterLast)
     {
-      auto retVal = internal::GetStringFromUrlPartInternal<UriTextRangeType, UrlReturnType>(range);
-      if (!retVal.empty())
+      state_.uri = &this->uriObj_;
+      this->textFirst_ = first;
+      this->textAfterLast_ = afterLast;
+      if (UriApiTypes::parseUriEx(&state_, first, afterLast) != URI_SUCCESS)
       {
-        return boost::optional<UrlReturnType>(retVal);
+        throw std::runtime_error("uriparser: Uri entry creation failed");
       }
-      return boost::optional<UrlReturnType>();
     }
 
-    UriApiTypes uriTypes_;
     UriStateType state_;
-    UriObjType uriObj_;
-    boost::optional<UriQuery<UrlReturnType>> lazy_query_;
+    internal::UriTextStorage<CharType> text_;
     std::atomic<bool> freeMemoryOnClose_;
   };
 
+  // Long-living parser for streams of urls. Path segments & host data of every
+  // parse are taken from an arena owned by the parser, so once the arena has grown
+  // to fit the longest url seen parse() does not allocate anymore.
+  // The result stays valid until the next parse() call.
+  template <class UrlTextType>
+  class Parser: boost::noncopyable
+  {
+    typedef typename internal::base_type<UrlTextType>::type CharType;
+    typedef typename ParsedUri<UrlTextType>::UriApiTypes UriApiTypes;
+    typedef typename ParsedUri<UrlTextType>::UriStateType UriStateType;
+    typedef typename ParsedUri<UrlTextType>::UriPathSegmentType UriPathSegmentType;
+  public:
+    Parser()
+    {
+      arena_.buffer = nullptr;
+      arena_.size = 0;
+      arena_.used = 0;
+      state_.uri = &parsed_.uriObj_;
+    }
+
+    ~Parser()
+    {
+      UriApiTypes::freeUriMembers(&parsed_.uriObj_);
+    }
+
+    const ParsedUri<UrlTextType>& parse(UrlTextType first, UrlTextType afterLast)
+    {
+      UriApiTypes::freeUriMembers(&parsed_.uriObj_);
+      parsed_.ResetLazyParts();
+      ReserveArena(first, afterLast);
+      parsed_.textFirst_ = first;
+      parsed_.textAfterLast_ = afterLast;
+
+      if (UriApiTypes::parseUriExArena(&state_, first, afterLast, &arena_) != URI_SUCCESS)
+      {
+        throw std::runtime_error("uriparser: Uri parsing failed");
+      }
+      return parsed_;
+    }
+
+    const ParsedUri<UrlTextType>& parse(UrlTextType urlText)
+    {
+      return parse(urlText, urlText + std::char_traits<CharType>::length(urlText));
+    }
+
+  private:
+    // Every '/' starts at most one path segment, plus a leading relative one
+    void ReserveArena(UrlTextType first, UrlTextType afterLast)
+    {
+      const std::size_t align = sizeof(void*);
+      const std::size_t segmentCount = std::count(first, afterLast, static_cast<CharType>('/')) + 1;
+      const std::size_t required = segmentCount * (sizeof(UriPathSegmentType) + align)
+        + sizeof(UriIp4) + sizeof(UriIp6) + 2 * align;
+
+      if (required > storage_.size() * sizeof(void*))
+      {
+        storage_.resize((required + sizeof(void*) - 1) / sizeof(void*));
+        arena_.buffer = storage_.data();
+        arena_.size = storage_.size() * sizeof(void*);
+      }
+      arena_.used = 0;
+    }
+
+    std::vector<void*> storage_;
+    UriArena arena_;
+    UriStateType state_;
+    ParsedUri<UrlTextType> parsed_;
+  };
+
   // Use this helper proc to create UriEntry obj
   template <typename T>
   UriEntry<T> UriParseUrl(T url)
@@ -262,6 +942,22 @@ namespace uri_parser
     return UriEntry<T>(url);
   }
     
+  inline UriEntry<const char*> UriParseUrl(std::string&& url)
+  {
+    return UriEntry<const char*>(std::move(url));
+  }
+
+  inline UriEntry<const wchar_t*> UriParseUrl(std::wstring&& url)
+  {
+    return UriEntry<const wchar_t*>(std::move(url));
+  }
+
+  template <typename T>
+  UriEntry<T> UriParseUrl(T url, UriArena& arena)
+  {
+    return UriEntry<T>(url, arena);
+  }
+
   template <typename T>
   UriEntry<T> ParseUrlWithHost(T url)
   {
@@ -276,4 +972,34 @@ namespace uri_parser
 
     return retVal;
   }
+
+  // Several query parameters out of one url in a single scan, see QueryParamSet
+  template <typename UrlTextType, typename CharType, std::size_t Count>
+  std::array<UriQueryViewItem<CharType>, Count> ExtractParams(const ParsedUri<UrlTextType>& entry, const QueryParamSet<CharType, Count>& keys,
+    bool plusToSpace = true)
+  {
+    return ExtractParams(entry.QueryItems(plusToSpace), keys);
+  }
+
+  template <typename UrlTextType, typename CharType, std::size_t Count>
+  std::array<UriQueryViewItem<CharType>, Count> ExtractParams(const ParsedUri<UrlTextType>& entry, const CharType* const (&keys)[Count],
+    bool plusToSpace = true)
+  {
+    return ExtractParams(entry.QueryItems(plusToSpace), QueryParamSet<CharType, Count>(keys));
+  }
+
+  // Canonical query of a url (cache keys...), see QueryCanonicalPolicy
+  template <typename UrlTextType, typename CharType>
+  std::size_t CanonicalizeQuery(const ParsedUri<UrlTextType>& entry, const QueryCanonicalPolicy<CharType>& policy,
+    CharType* out, std::size_t outSize, bool plusToSpace = true)
+  {
+    return CanonicalizeQuery(entry.QueryItems(plusToSpace), policy, out, outSize);
+  }
+
+  template <typename UrlTextType, typename CharType>
+  std::basic_string<CharType>& CanonicalizeQuery(const ParsedUri<UrlTextType>& entry, const QueryCanonicalPolicy<CharType>& policy,
+    std::basic_string<CharType>& out, bool plusToSpace = true)
+  {
+    return CanonicalizeQuery(entry.QueryItems(plusToSpace), policy, out);
+  }
 } // namespace uri_parser
\ No newline at end of file
@@ -0,0 +1,716 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_view.hpp>
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+#include "cpp_uriparser.h"
+#include "cpp_uriparser_simd.h"
+
+namespace uri_parser
+{
+  namespace internal
+  {
+    // Positions of the delimiters the fast path needs, npos if absent
+    struct UriDelimiterScan
+    {
+      static const std::size_t npos = static_cast<std::size_t>(-1);
+
+      std::size_t colon;
+      std::size_t question;
+      std::size_t hash;
+      std::size_t at;
+      std::size_t bracket;
+      std::size_t slashCount;
+    };
+
+    template <class CharType>
+    void ScanDelimitersScalar(const CharType* text, std::size_t pos, std::size_t size, UriDelimiterScan& scan)
+    {
+      for (; pos < size; ++pos)
+      {
+        switch (text[pos])
+        {
+        case ':': if (scan.colon == UriDelimiterScan::npos) scan.colon = pos; break;
+        case '?': if (scan.question == UriDelimiterScan::npos) scan.question = pos; break;
+        case '#': if (scan.hash == UriDelimiterScan::npos) scan.hash = pos; break;
+        case '@': if (scan.at == UriDelimiterScan::npos) scan.at = pos; break;
+        case '[': if (scan.bracket == UriDelimiterScan::npos) scan.bracket = pos; break;
+        case '/': ++scan.slashCount; break;
+        default: break;
+        }
+      }
+    }
+
+    inline void RecordFirst(std::size_t& found, unsigned int mask, std::size_t blockPos)
+    {
+      if (mask != 0 && found == UriDelimiterScan::npos)
+      {
+        found = blockPos + LowestBit(mask);
+      }
+    }
+
+    template <class CharType>
+    UriDelimiterScan ScanDelimiters(const CharType* text, std::size_t size)
+    {
+      UriDelimiterScan scan = {UriDelimiterScan::npos, UriDelimiterScan::npos, UriDelimiterScan::npos,
+        UriDelimiterScan::npos, UriDelimiterScan::npos, 0};
+      ScanDelimitersScalar(text, 0, size, scan);
+      return scan;
+    }
+
+    // char urls are scanned 16 (SSE2) or 32 (AVX2) bytes at a time
+    template <>
+    inline UriDelimiterScan ScanDelimiters<char>(const char* text, std::size_t size)
+    {
+      UriDelimiterScan scan = {UriDelimiterScan::npos, UriDelimiterScan::npos, UriDelimiterScan::npos,
+        UriDelimiterScan::npos, UriDelimiterScan::npos, 0};
+      std::size_t pos = 0;
+
+#if defined(CPP_URIPARSER_AVX2)
+      const __m256i colon = _mm256_set1_epi8(':');
+      const __m256i question = _mm256_set1_epi8('?');
+      const __m256i hash = _mm256_set1_epi8('#');
+      const __m256i at = _mm256_set1_epi8('@');
+      const __m256i bracket = _mm256_set1_epi8('[');
+      const __m256i slash = _mm256_set1_epi8('/');
+      for (; pos + 32 <= size; pos += 32)
+      {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+        RecordFirst(scan.colon, static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, colon))), pos);
+        RecordFirst(scan.question, static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, question))), pos);
+        RecordFirst(scan.hash, static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, hash))), pos);
+        RecordFirst(scan.at, static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, at))), pos);
+        RecordFirst(scan.bracket, static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, bracket))), pos);
+        scan.slashCount += CountBits(static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, slash))));
+      }
+#elif defined(CPP_URIPARSER_SSE2)
+      const __m128i colon = _mm_set1_epi8(':');
+      const __m128i question = _mm_set1_epi8('?');
+      const __m128i hash = _mm_set1_epi8('#');
+      const __m128i at = _mm_set1_epi8('@');
+      const __m128i bracket = _mm_set1_epi8('[');
+      const __m128i slash = _mm_set1_epi8('/');
+      for (; pos + 16 <= size; pos += 16)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+        RecordFirst(scan.colon, static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, colon))), pos);
+        RecordFirst(scan.question, static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, question))), pos);
+        RecordFirst(scan.hash, static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, hash))), pos);
+        RecordFirst(scan.at, static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, at))), pos);
+        RecordFirst(scan.bracket, static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, bracket))), pos);
+        scan.slashCount += CountBits(static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, slash))));
+      }
+#endif
+
+      ScanDelimitersScalar(text, pos, size, scan);
+      return scan;
+    }
+
+    // Character classes of RFC 3986 the fast path accepts without looking closer
+    enum UriCharClass
+    {
+      URI_CLASS_SCHEME = 1 << 0, // ALPHA / DIGIT / "+" / "-" / "."
+      URI_CLASS_HOST = 1 << 1, // unreserved, plain reg-name only
+      URI_CLASS_PCHAR = 1 << 2, // unreserved / sub-delims / ":" / "@", '%' checked separately
+      URI_CLASS_QUERY = 1 << 3 // pchar / "/" / "?"
+    };
+
+    inline const unsigned char* UriCharClassTable()
+    {
+      struct Table
+      {
+        unsigned char classes[256];
+        Table()
+        {
+          for (int ch = 0; ch < 256; ++ch)
+          {
+            const bool alnum = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+            const bool unreserved = alnum || ch == '-' || ch == '.' || ch == '_' || ch == '~';
+            const bool subDelim = ch == '!' || ch == '$' || ch == '&' || ch == '\'' || ch == '(' || ch == ')'
+              || ch == '*' || ch == '+' || ch == ',' || ch == ';' || ch == '=';
+            const bool pchar = unreserved || subDelim || ch == ':' || ch == '@';
+
+            classes[ch] = static_cast<unsigned char>(
+              ((alnum || ch == '+' || ch == '-' || ch == '.') ? URI_CLASS_SCHEME : 0)
+              | (unreserved ? URI_CLASS_HOST : 0)
+              | (pchar ? URI_CLASS_PCHAR : 0)
+              | ((pchar || ch == '/' || ch == '?') ? URI_CLASS_QUERY : 0));
+          }
+        }
+      };
+      static const Table table;
+      return table.classes;
+    }
+
+    template <class CharType>
+    bool HasCharClass(CharType ch, unsigned char charClass)
+    {
+      const unsigned int code = static_cast<unsigned int>(ch);
+      return code < 256 && (UriCharClassTable()[code] & charClass) != 0;
+    }
+
+    template <class CharType>
+    bool IsHexDigit(CharType ch)
+    {
+      return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+    }
+
+    // Checks [first, afterLast) against charClass, '%' must start a full pct-encoded triple
+    template <class CharType>
+    bool IsValidComponent(const CharType* first, const CharType* afterLast, unsigned char charClass)
+    {
+      for (; first < afterLast; ++first)
+      {
+        if (*first == '%')
+        {
+          if (afterLast - first < 3 || !IsHexDigit(first[1]) || !IsHexDigit(first[2]))
+          {
+            return false;
+          }
+          first += 2;
+        }
+        else if (!HasCharClass(*first, charClass))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    template <class CharType>
+    bool IsAllDigits(const CharType* first, const CharType* afterLast, bool allowDots)
+    {
+      for (; first < afterLast; ++first)
+      {
+        if (!(*first >= '0' && *first <= '9') && !(allowDots && *first == '.'))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Same bump allocation as the parser's arena, but never spills to the heap
+    inline void* UriArenaTake(UriArena& arena, std::size_t size)
+    {
+      const std::size_t align = sizeof(void*);
+      const std::size_t offset = (arena.used + align - 1) & ~(align - 1);
+      if (offset > arena.size || size > arena.size - offset)
+      {
+        return nullptr;
+      }
+      arena.used = offset + size;
+      return static_cast<char*>(arena.buffer) + offset;
+    }
+
+    // Fills uri for urls shaped scheme://host[:port][/path][?query][#fragment] with a plain
+    // reg-name host. Returns false for anything else, uri is left untouched in that case
+    // and the caller falls back to the full grammar.
+    template <class UriObjType, class CharType>
+    bool FastParseUri(UriObjType& uri, const CharType* text, std::size_t size,
+      const UriDelimiterScan& scan, UriArena& arena)
+    {
+      typedef typename std::remove_pointer<decltype(uri.pathHead)>::type UriPathSegmentType;
+
+      const std::size_t colon = scan.colon;
+      if (colon == UriDelimiterScan::npos || colon == 0 || colon + 3 > size
+        || text[colon + 1] != '/' || text[colon + 2] != '/')
+      {
+        return false;
+      }
+      if (!((text[0] >= 'a' && text[0] <= 'z') || (text[0] >= 'A' && text[0] <= 'Z'))
+        || !IsValidComponent(text + 1, text + colon, URI_CLASS_SCHEME)
+        || (scan.question != UriDelimiterScan::npos && scan.question < colon)
+        || (scan.hash != UriDelimiterScan::npos && scan.hash < colon))
+      {
+        return false;
+      }
+
+      const std::size_t fragmentPos = scan.hash;
+      const std::size_t queryPos = (scan.question != UriDelimiterScan::npos && scan.question < fragmentPos)
+        ? scan.question : UriDelimiterScan::npos;
+      const std::size_t afterPathPos = std::min(std::min(queryPos, fragmentPos), size);
+
+      // authority: no user info, no IP literal
+      const std::size_t hostPos = colon + 3;
+      std::size_t authorityEnd = hostPos;
+      while (authorityEnd < afterPathPos && text[authorityEnd] != '/')
+      {
+        ++authorityEnd;
+      }
+      if ((scan.at != UriDelimiterScan::npos && scan.at < authorityEnd)
+        || (scan.bracket != UriDelimiterScan::npos && scan.bracket < authorityEnd))
+      {
+        return false;
+      }
+
+      std::size_t hostEnd = hostPos;
+      while (hostEnd < authorityEnd && text[hostEnd] != ':')
+      {
+        ++hostEnd;
+      }
+      const bool hasPort = hostEnd < authorityEnd;
+      if (hostEnd == hostPos
+        || !IsValidComponent(text + hostPos, text + hostEnd, URI_CLASS_HOST)
+        || IsAllDigits(text + hostPos, text + hostEnd, true) // might be IPv4
+        || (hasPort && (hostEnd + 1 == authorityEnd || !IsAllDigits(text + hostEnd + 1, text + authorityEnd, false))))
+      {
+        return false;
+      }
+
+      const CharType* queryFirst = queryPos != UriDelimiterScan::npos ? text + queryPos + 1 : nullptr;
+      const CharType* queryAfterLast = queryFirst != nullptr ? text + std::min(fragmentPos, size) : nullptr;
+      const CharType* fragmentFirst = fragmentPos != UriDelimiterScan::npos ? text + fragmentPos + 1 : nullptr;
+      if ((queryFirst != nullptr && !IsValidComponent(queryFirst, queryAfterLast, URI_CLASS_QUERY))
+        || (fragmentFirst != nullptr && !IsValidComponent(fragmentFirst, text + size, URI_CLASS_QUERY)))
+      {
+        return false;
+      }
+
+      // path segments, each one behind a '/'
+      const UriArena arenaBackup = arena;
+      UriPathSegmentType* pathHead = nullptr;
+      UriPathSegmentType* pathTail = nullptr;
+      std::size_t segmentPos = authorityEnd;
+      while (segmentPos < afterPathPos)
+      {
+        std::size_t segmentEnd = segmentPos + 1;
+        while (segmentEnd < afterPathPos && text[segmentEnd] != '/')
+        {
+          ++segmentEnd;
+        }
+
+        UriPathSegmentType* segment = static_cast<UriPathSegmentType*>(UriArenaTake(arena, sizeof(UriPathSegmentType)));
+        if (segment == nullptr || !IsValidComponent(text + segmentPos + 1, text + segmentEnd, URI_CLASS_PCHAR))
+        {
+          arena = arenaBackup;
+          return false;
+        }
+        memset(segment, 0, sizeof(UriPathSegmentType));
+        segment->text.first = text + segmentPos + 1;
+        segment->text.afterLast = text + segmentEnd;
+        if (pathHead == nullptr)
+        {
+          pathHead = segment;
+        }
+        else
+        {
+          pathTail->next = segment;
+        }
+        pathTail = segment;
+        segmentPos = segmentEnd;
+      }
+
+      memset(&uri, 0, sizeof(uri));
+      uri.scheme.first = text;
+      uri.scheme.afterLast = text + colon;
+      uri.hostText.first = text + hostPos;
+      uri.hostText.afterLast = text + hostEnd;
+      if (hasPort)
+      {
+        uri.portText.first = text + hostEnd + 1;
+        uri.portText.afterLast = text + authorityEnd;
+      }
+      uri.pathHead = pathHead;
+      uri.pathTail = pathTail;
+      uri.query.first = queryFirst;
+      uri.query.afterLast = queryAfterLast;
+      uri.fragment.first = fragmentFirst;
+      uri.fragment.afterLast = fragmentFirst != nullptr ? text + size : nullptr;
+      uri.reserved = &arena;
+      return true;
+    }
+
+    // Worker threads kept alive between rounds of work. Run(workers, task) calls
+    // task(worker) for every worker index, index 0 on the calling thread, and
+    // returns once all of them are done; missing threads are started on demand.
+    // Started threads belong to the pool whatever happens, the destructor joins them.
+    class BatchWorkerPool: boost::noncopyable
+    {
+    public:
+      BatchWorkerPool() :
+        invoke_(nullptr),
+        context_(nullptr),
+        workers_(0),
+        pending_(0),
+        generation_(0),
+        stop_(false){}
+
+      ~BatchWorkerPool()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_)
+        {
+          thread.join();
+        }
+      }
+
+      template <class Task>
+      void Run(unsigned int workers, Task& task)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          // a failing start leaves the threads started so far to the destructor
+          while (threads_.size() + 1 < workers)
+          {
+            threads_.emplace_back(&BatchWorkerPool::Loop, this, static_cast<unsigned int>(threads_.size() + 1));
+          }
+          invoke_ = &Invoke<Task>;
+          context_ = &task;
+          workers_ = workers;
+          pending_ = workers - 1;
+          ++generation_;
+        }
+        wake_.notify_all();
+
+        std::exception_ptr failure;
+        try
+        {
+          task(0);
+        }
+        catch (...)
+        {
+          failure = std::current_exception();
+        }
+
+        // the other workers still use task, wait for them in any case
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]{ return pending_ == 0; });
+        invoke_ = nullptr;
+        context_ = nullptr;
+        lock.unlock();
+        if (failure)
+        {
+          std::rethrow_exception(failure);
+        }
+      }
+
+    private:
+      template <class Task>
+      static void Invoke(void* context, unsigned int worker)
+      {
+        (*static_cast<Task*>(context))(worker);
+      }
+
+      void Loop(unsigned int worker)
+      {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;)
+        {
+          wake_.wait(lock, [&]{ return stop_ || generation_ != seen; });
+          if (stop_)
+          {
+            return;
+          }
+          seen = generation_;
+          if (worker >= workers_)
+          {
+            continue;
+          }
+          void (*invoke)(void*, unsigned int) = invoke_;
+          void* context = context_;
+          lock.unlock();
+          // tasks report their own errors, one escaping here must not end the process
+          try
+          {
+            invoke(context, worker);
+          }
+          catch (...)
+          {
+          }
+          lock.lock();
+          if (--pending_ == 0)
+          {
+            done_.notify_all();
+          }
+        }
+      }
+
+      std::vector<std::thread> threads_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      std::condition_variable done_;
+      void (*invoke_)(void*, unsigned int);
+      void* context_;
+      unsigned int workers_;
+      unsigned int pending_;
+      unsigned long long generation_; // never wraps in practice, fresh threads start from 0
+      bool stop_;
+    };
+  } // namespace internal
+
+  // Results of ParseBatch, owns the parsed members of every url in one arena.
+  // Reusing the same object for the next batch keeps its memory.
+  template <class UrlTextType>
+  class ParsedBatch: boost::noncopyable
+  {
+    typedef typename ParsedUri<UrlTextType>::UriApiTypes UriApiTypes;
+    typedef typename ParsedUri<UrlTextType>::UriStateType UriStateType;
+    typedef typename ParsedUri<UrlTextType>::UriPathSegmentType UriPathSegmentType;
+    typedef typename ParsedUri<UrlTextType>::CharType CharType;
+  public:
+    typedef typename ParsedUri<UrlTextType>::UrlViewType UrlViewType;
+
+    ParsedBatch() :
+      fastPathCount_(0)
+    {
+      arena_.buffer = nullptr;
+      arena_.size = 0;
+      arena_.used = 0;
+    }
+
+    ~ParsedBatch()
+    {
+      Clear();
+    }
+
+    std::size_t size() const { return errors_.size(); }
+
+    // URI_SUCCESS or the error code of the C parser
+    int error(std::size_t index) const { return errors_[index]; }
+
+    // Only meaningful if error(index) == URI_SUCCESS
+    const ParsedUri<UrlTextType>& operator[](std::size_t index) const { return results_[index]; }
+
+    // How many urls of the last batch skipped the full grammar
+    std::size_t fastPathCount() const { return fastPathCount_; }
+
+    // urls: anything with data() & size() over CharType, string views or strings
+    template <class UrlItemType>
+    void Parse(const UrlItemType* urls, std::size_t count)
+    {
+      Clear();
+      scans_.resize(count);
+      results_.resize(count);
+      errors_.assign(count, URI_SUCCESS);
+
+      // one pass over every url finds the delimiters & sizes the arena for the whole batch
+      const std::size_t align = sizeof(void*);
+      std::size_t required = 0;
+      for (std::size_t idx = 0; idx < count; ++idx)
+      {
+        scans_[idx] = internal::ScanDelimiters(urls[idx].data(), urls[idx].size());
+        required += (scans_[idx].slashCount + 1) * (sizeof(UriPathSegmentType) + align)
+          + sizeof(UriIp4) + sizeof(UriIp6) + 2 * align;
+      }
+      ReserveArena(required);
+
+      for (std::size_t idx = 0; idx < count; ++idx)
+      {
+        const CharType* text = urls[idx].data();
+        ParsedUri<UrlTextType>& result = results_[idx];
+        result.ResetLazyParts();
+        result.textFirst_ = text;
+        result.textAfterLast_ = text + urls[idx].size();
+
+        if (internal::FastParseUri(result.uriObj_, text, urls[idx].size(), scans_[idx], arena_))
+        {
+          ++fastPathCount_;
+          continue;
+        }
+
+        UriStateType state;
+        state.uri = &result.uriObj_;
+        errors_[idx] = UriApiTypes::parseUriExArena(&state, text, result.textAfterLast_, &arena_);
+      }
+    }
+
+    void Clear()
+    {
+      for (std::size_t idx = 0; idx < results_.size(); ++idx)
+      {
+        UriApiTypes::freeUriMembers(&results_[idx].uriObj_);
+      }
+      errors_.clear();
+      arena_.used = 0;
+      fastPathCount_ = 0;
+    }
+
+  private:
+    void ReserveArena(std::size_t required)
+    {
+      if (required > storage_.size() * sizeof(void*))
+      {
+        storage_.resize((required + sizeof(void*) - 1) / sizeof(void*));
+        arena_.buffer = storage_.data();
+        arena_.size = storage_.size() * sizeof(void*);
+      }
+      arena_.used = 0;
+    }
+
+    std::vector<void*> storage_;
+    UriArena arena_;
+    std::vector<internal::UriDelimiterScan> scans_;
+    std::vector<ParsedUri<UrlTextType>> results_;
+    std::vector<int> errors_;
+    std::size_t fastPathCount_;
+  };
+
+  // Parses every url of [urls, urls + count) into output. Common
+  // scheme://host/path?query shapes skip the recursive descent of the C parser,
+  // everything else goes through the full grammar. The urls are string views or
+  // strings, read in place: the texts must outlive output and stay unchanged.
+  template <class UrlItemType, class UrlTextType>
+  void ParseBatch(const UrlItemType* urls, std::size_t count, ParsedBatch<UrlTextType>& output)
+  {
+    output.Parse(urls, count);
+  }
+
+  template <class UrlItemType, class UrlTextType>
+  void ParseBatch(const std::vector<UrlItemType>& urls, ParsedBatch<UrlTextType>& output)
+  {
+    output.Parse(urls.data(), urls.size());
+  }
+
+  // Results of ParallelParse in input order. Every chunk of the input has its own
+  // ParsedBatch (arena + result slab), filled by whichever worker parsed the chunk.
+  // Parsing again with the same object reuses its chunks and its worker threads.
+  template <class UrlTextType>
+  class ParallelParseResult: boost::noncopyable
+  {
+  public:
+    typedef ParsedBatch<UrlTextType> ChunkType;
+
+    ParallelParseResult() :
+      chunkSize_(1),
+      size_(0){}
+
+    ParallelParseResult(ParallelParseResult&& right) :
+      pool_(std::move(right.pool_)),
+      chunks_(std::move(right.chunks_)),
+      chunkSize_(right.chunkSize_),
+      size_(right.size_)
+    {
+      right.size_ = 0;
+    }
+
+    std::size_t size() const { return size_; }
+
+    int error(std::size_t index) const
+    {
+      return chunks_[index / chunkSize_]->error(index % chunkSize_);
+    }
+
+    const ParsedUri<UrlTextType>& operator[](std::size_t index) const
+    {
+      return (*chunks_[index / chunkSize_])[index % chunkSize_];
+    }
+
+    std::size_t chunkCount() const { return chunks_.size(); }
+
+    template <class UrlItemType>
+    void Parse(const UrlItemType* urls, std::size_t count, unsigned int threads)
+    {
+      if (threads == 0)
+      {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      }
+
+      // a few chunks per worker leave something to steal when the urls are uneven
+      const std::size_t minChunkSize = 64;
+      chunkSize_ = std::max<std::size_t>(minChunkSize, (count + threads * 8 - 1) / (threads * 8));
+      size_ = count;
+
+      const std::size_t chunkCount = (count + chunkSize_ - 1) / chunkSize_;
+      threads = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(threads, chunkCount)));
+      chunks_.resize(chunkCount);
+      for (auto& chunk : chunks_)
+      {
+        if (!chunk)
+        {
+          chunk.reset(new ChunkType());
+        }
+      }
+
+      // every worker starts on its own contiguous run of chunks and steals from the others when done
+      std::unique_ptr<WorkerRange[]> ranges(new WorkerRange[threads]);
+      for (unsigned int worker = 0; worker < threads; ++worker)
+      {
+        ranges[worker].next = chunkCount * worker / threads;
+        ranges[worker].afterLast = chunkCount * (worker + 1) / threads;
+      }
+
+      std::exception_ptr failure;
+      std::atomic<bool> failed(false);
+      auto work = [&](unsigned int self)
+      {
+        try
+        {
+          for (unsigned int victim = 0; victim < threads; ++victim)
+          {
+            WorkerRange& range = ranges[(self + victim) % threads];
+            for (std::size_t chunk = range.next++; chunk < range.afterLast; chunk = range.next++)
+            {
+              const std::size_t first = chunk * chunkSize_;
+              chunks_[chunk]->Parse(urls + first, std::min(chunkSize_, count - first));
+            }
+          }
+        }
+        catch (...)
+        {
+          if (!failed.exchange(true))
+          {
+            failure = std::current_exception();
+          }
+        }
+      };
+
+      if (threads == 1)
+      {
+        work(0);
+      }
+      else
+      {
+        if (!pool_)
+        {
+          pool_.reset(new internal::BatchWorkerPool());
+        }
+        pool_->Run(threads, work);
+      }
+
+      if (failure)
+      {
+        std::rethrow_exception(failure);
+      }
+    }
+
+  private:
+    struct WorkerRange
+    {
+      std::atomic<std::size_t> next;
+      std::size_t afterLast;
+    };
+
+    std::unique_ptr<internal::BatchWorkerPool> pool_;
+    std::vector<std::unique_ptr<ChunkType>> chunks_;
+    std::size_t chunkSize_;
+    std::size_t size_;
+  };
+
+  // Parses a large set of urls on several threads (0 = one per core). input
+  // holds string views or strings, nothing is copied: the results point into
+  // the texts, so they must outlive the result unchanged. For strings that is
+  // the vector itself, short ones keep their text inside the string object.
+  template <class UrlItemType>
+  ParallelParseResult<const typename UrlItemType::value_type*> ParallelParse(
+    const std::vector<UrlItemType>& input, unsigned int threads = 0)
+  {
+    ParallelParseResult<const typename UrlItemType::value_type*> result;
+    result.Parse(input.data(), input.size(), threads);
+    return result;
+  }
+} // namespace uri_parser
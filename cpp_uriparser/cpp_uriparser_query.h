@@ -5,9 +5,23 @@
 #include <iterator>
 #include <string>
 #include <list>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <limits>
+#include <clocale>
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/config.hpp>
 #include <boost/optional.hpp>
+#include <boost/preprocessor/repetition/repeat.hpp>
+#include <boost/utility/string_view.hpp>
 #include <type_traits>
 #include "uriparser/Uri.h"
+#include "cpp_uriparser_simd.h"
 
 namespace uri_parser
 {
@@ -45,31 +59,65 @@ namespace uri_parser
       static const bool value = true;
     };
 
-    // default API types
+    // default API types, plain forwarders to the C api resolved at compile time
 #define URI_API_TYPES(PREFIX) \
       typedef UriUri##PREFIX UriObjType; \
       typedef UriParserState##PREFIX UriStateType; \
       typedef UriPathSegment##PREFIX UriPathSegmentType; \
       typedef UriQueryListStruct##PREFIX UriQueryListType; \
-      \
-      std::function<int(UriStateType*, UrlTextType)> parseUri; /*NOLINT*/ \
-      std::function<void(UriObjType*)> freeUriMembers;  \
-      std::function<int(UriObjType*)> uriNormalizeSyntax; \
       typedef decltype(UriQueryListType::key) QueryListCharType;  \
-      std::function<int(UriQueryListType**, int*, QueryListCharType, QueryListCharType)> uriDissectQueryMalloc; \
-      std::function<void(UriQueryListType*)> uriFreeQueryList;  \
+      \
+      static int parseUri(UriStateType* state, UrlTextType text) /*NOLINT*/ \
+      { \
+        return uriParseUri##PREFIX(state, text); \
+      } \
+      static int parseUriEx(UriStateType* state, typename base_const_ptr<UrlTextType>::type first, typename base_const_ptr<UrlTextType>::type afterLast) \
+      { \
+        return uriParseUriEx##PREFIX(state, first, afterLast); \
+      } \
+      static int parseUriExArena(UriStateType* state, typename base_const_ptr<UrlTextType>::type first, \
+        typename base_const_ptr<UrlTextType>::type afterLast, UriArena* arena) \
+      { \
+        return uriParseUriExArena##PREFIX(state, first, afterLast, arena); \
+      } \
+      static void freeUriMembers(UriObjType* uri) \
+      { \
+        uriFreeUriMembers##PREFIX(uri); \
+      } \
+      static int uriNormalizeSyntax(UriObjType* uri) \
+      { \
+        return uriNormalizeSyntax##PREFIX(uri); \
+      } \
+      static int uriDissectQueryMalloc(UriQueryListType** dest, int* itemCount, QueryListCharType first, QueryListCharType afterLast) \
+      { \
+        return uriDissectQueryMalloc##PREFIX(dest, itemCount, first, afterLast); \
+      } \
+      static void uriFreeQueryList(UriQueryListType* queryList) \
+      { \
+        uriFreeQueryList##PREFIX(queryList); \
+      } \
+      static int uriDissectQueryIntoBuffer(UriQueryListType** dest, int* itemCount, QueryListCharType first, QueryListCharType afterLast, \
+        void* buffer, std::size_t bufferSize, std::size_t* bytesRequired) \
+      { \
+        return uriDissectQueryIntoBuffer##PREFIX(dest, itemCount, first, afterLast, URI_TRUE, URI_BR_DONT_TOUCH, \
+          buffer, bufferSize, bytesRequired); \
+      } \
+      static void uriFreeQueryListBuffer(UriQueryListType* queryList) \
+      { \
+        uriFreeQueryListBuffer##PREFIX(queryList); \
+      } \
+      static typename base_ptr<UrlTextType>::type uriEscapeEx(typename base_const_ptr<UrlTextType>::type first, \
+        typename base_const_ptr<UrlTextType>::type afterLast, typename base_ptr<UrlTextType>::type out, \
+        UriBool spaceToPlus, UriBool normalizeBreaks) \
+      { \
+        return uriEscapeEx##PREFIX(first, afterLast, out, spaceToPlus, normalizeBreaks); \
+      } \
       /* add_const to support UrlTextType == tchar* & const tchar* ( api output is exactly const tchar* )*/ \
-      std::function<typename base_const_ptr<UrlTextType>::type  \
-        (typename base_ptr<UrlTextType>::type, UriBool, UriBreakConversion)> uriUnescapeInPlaceEx;  \
-        \
-      UriTypes() :  \
-        parseUri(&uriParseUri##PREFIX),  \
-        freeUriMembers(&uriFreeUriMembers##PREFIX),  \
-        uriNormalizeSyntax(&uriNormalizeSyntax##PREFIX), \
-        uriUnescapeInPlaceEx(&uriUnescapeInPlaceEx##PREFIX), \
-        uriDissectQueryMalloc(&uriDissectQueryMalloc##PREFIX), \
-        uriFreeQueryList(&uriFreeQueryList##PREFIX)  \
-     {}
+      static typename base_const_ptr<UrlTextType>::type uriUnescapeInPlaceEx( \
+        typename base_ptr<UrlTextType>::type inout, UriBool plusToSpace, UriBreakConversion breakConversion) \
+      { \
+        return uriUnescapeInPlaceEx##PREFIX(inout, plusToSpace, breakConversion); \
+      }
 
 
     // by default lets use ANSI api functions
@@ -77,6 +125,7 @@ namespace uri_parser
     struct UriTypes
     {
       typedef std::string UrlReturnType;
+      typedef boost::string_view UrlViewType;
       URI_API_TYPES(A)
     };
 
@@ -84,6 +133,7 @@ namespace uri_parser
     struct UriTypes<UrlTextType, typename std::enable_if<std::is_convertible<UrlTextType, const wchar_t*>::value >::type>
     {
       typedef std::wstring UrlReturnType;
+      typedef boost::wstring_view UrlViewType;
       URI_API_TYPES(W)
     };
 
@@ -97,6 +147,90 @@ namespace uri_parser
 
       return UrlReturnType(range.first, range.afterLast);
     }
+
+    template <class UriTextRangeType, class UrlViewType>
+    UrlViewType GetViewFromUrlPartInternal(const UriTextRangeType& range)
+    {
+      if (range.first == nullptr || (range.afterLast == nullptr))
+      {
+        return UrlViewType();
+      }
+
+      return UrlViewType(range.first, range.afterLast - range.first);
+    }
+
+    // Owned copy of the url text, NUL-terminated. Short urls stay inline,
+    // longer ones go to the heap (or keep the buffer of the string moved in).
+    template <class CharType, std::size_t InlineSize = 128>
+    class UriTextStorage
+    {
+    public:
+      UriTextStorage() :
+        size_(0),
+        onHeap_(false)
+      {
+        inline_[0] = 0;
+      }
+
+      UriTextStorage(UriTextStorage&& right) :
+        size_(0),
+        onHeap_(false)
+      {
+        *this = std::move(right);
+      }
+
+      UriTextStorage& operator=(UriTextStorage&& right)
+      {
+        size_ = right.size_;
+        onHeap_ = right.onHeap_;
+        if (onHeap_)
+        {
+          heap_ = std::move(right.heap_);
+        }
+        else
+        {
+          std::copy(right.inline_, right.inline_ + size_ + 1, inline_);
+        }
+        return *this;
+      }
+
+      const CharType* Assign(const CharType* first, const CharType* afterLast)
+      {
+        size_ = afterLast - first;
+        onHeap_ = size_ >= InlineSize;
+        if (onHeap_)
+        {
+          heap_.assign(first, afterLast);
+        }
+        else
+        {
+          std::copy(first, afterLast, inline_);
+          inline_[size_] = 0;
+        }
+        return data();
+      }
+
+      const CharType* Assign(std::basic_string<CharType>&& text)
+      {
+        if (text.size() < InlineSize)
+        {
+          return Assign(text.data(), text.data() + text.size());
+        }
+        size_ = text.size();
+        onHeap_ = true;
+        heap_ = std::move(text);
+        return data();
+      }
+
+      const CharType* data() const { return onHeap_ ? heap_.c_str() : inline_; }
+      std::size_t size() const { return size_; }
+
+    private:
+      CharType inline_[InlineSize];
+      std::basic_string<CharType> heap_;
+      std::size_t size_;
+      bool onHeap_;
+    };
   } // namespace internal
 
   template <class UrlReturnType>
@@ -106,6 +240,66 @@ namespace uri_parser
     UrlReturnType value;
   };
 
+  namespace internal
+  {
+    // FNV-1a, code unit by code unit
+    template <class CharType>
+    std::uint64_t HashQueryKey(const CharType* first, std::size_t size)
+    {
+      std::uint64_t hash = 14695981039346656037ull;
+      for (std::size_t idx = 0; idx < size; ++idx)
+      {
+        hash = (hash ^ static_cast<std::uint64_t>(first[idx])) * 1099511628211ull;
+      }
+      return hash;
+    }
+
+    // narrow keys go 8 bytes per multiply, short tails are read with fixed size
+    // (overlapping) loads so no memcpy call is left in the loop
+    inline std::uint64_t HashQueryKey(const char* first, std::size_t size)
+    {
+      const std::uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+      std::uint64_t hash = 14695981039346656037ull ^ size;
+      std::uint64_t word;
+      if (size >= 8)
+      {
+        const char* last = first + size - 8;
+        for (; first < last; first += 8)
+        {
+          memcpy(&word, first, 8);
+          hash = (hash ^ word) * multiplier;
+          hash ^= hash >> 29;
+        }
+        memcpy(&word, last, 8);
+      }
+      else if (size >= 4)
+      {
+        std::uint32_t head, tail;
+        memcpy(&head, first, 4);
+        memcpy(&tail, first + size - 4, 4);
+        word = (static_cast<std::uint64_t>(head) << 32) | tail;
+      }
+      else if (size > 0)
+      {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(first);
+        word = (static_cast<std::uint64_t>(bytes[0]) << 16) | (static_cast<std::uint64_t>(bytes[size >> 1]) << 8) | bytes[size - 1];
+      }
+      else
+      {
+        word = 0;
+      }
+      hash = (hash ^ word) * multiplier;
+      return hash ^ (hash >> 32);
+    }
+  } // namespace internal
+
+  // Turns a query value into T for UriQueryView::get / UriQuery::get.
+  // Specialize it for own types (enums, ids...): Convert gets the unescaped
+  // value and returns false if it does not fit. Built in: integers, floating
+  // point & bool ("1", "0", "true", "false").
+  template <class T, class CharType, class Enable = void>
+  struct UriQueryValueConverter;
+
   template <class UrlReturnType>
   class UriQuery:
     public std::vector<UriQueryItem<UrlReturnType>>
@@ -113,14 +307,82 @@ namespace uri_parser
   public:
     typedef typename std::vector<UriQueryItem<UrlReturnType>> ContainerType;
     typedef typename ContainerType::const_iterator QueryItemIteratorType;
+    typedef boost::basic_string_view<typename UrlReturnType::value_type> UrlViewType;
+
+    // Walks all items sharing one key, in query order
+    class KeyIterator: public std::iterator<std::forward_iterator_tag, UriQueryItem<UrlReturnType>,
+      std::ptrdiff_t, const UriQueryItem<UrlReturnType>*, const UriQueryItem<UrlReturnType>&>
+    {
+    public:
+      KeyIterator() :
+        query_(nullptr),
+        item_(kNoItem){}
+
+      KeyIterator(const UriQuery* query, std::uint32_t item) :
+        query_(query),
+        item_(item){}
+
+      const UriQueryItem<UrlReturnType>& operator*() const { return (*query_)[item_]; }
+      const UriQueryItem<UrlReturnType>* operator->() const { return &(*query_)[item_]; }
+
+      KeyIterator& operator++() { item_ = query_->NextWithSameKey(item_); return *this; }
+      KeyIterator operator++(int) { KeyIterator tmp(*this); ++*this; return tmp; }
+
+      bool operator==(const KeyIterator& right) const { return item_ == right.item_; }
+      bool operator!=(const KeyIterator& right) const { return item_ != right.item_; }
+
+    private:
+      const UriQuery* query_;
+      std::uint32_t item_;
+    };
+
+    // Queries shorter than this are scanned, the index does not pay off for them
+    static const std::size_t kIndexThreshold = 16;
+
+    UriQuery() :
+      indexedSize_(0),
+      autoIndex_(true){}
 
     // If failed returns end()
-    // If succ - iterator to element found
-    QueryItemIteratorType findKey(UrlReturnType keyStr) const
+    // If succ - iterator to element found (first one for duplicate keys)
+    QueryItemIteratorType findKey(UrlViewType keyStr) const
+    {
+      const std::uint32_t item = FindFirst(keyStr);
+      return item == kNoItem ? ContainerType::end() : ContainerType::begin() + item;
+    }
+
+    // All items with the key, in query order
+    std::pair<KeyIterator, KeyIterator> equal_range(UrlViewType keyStr) const
+    {
+      return std::make_pair(KeyIterator(this, FindFirst(keyStr)), KeyIterator(this, kNoItem));
+    }
+
+    // Value of the first item with key converted to T (see UriQueryValueConverter),
+    // none if the key is absent or the value does not convert
+    template <class T>
+    boost::optional<T> get(UrlViewType keyStr) const
+    {
+      auto item = findKey(keyStr);
+      T value;
+      if (item == ContainerType::end() || !UriQueryValueConverter<T, typename UrlReturnType::value_type>::Convert(item->value, value))
+      {
+        return boost::optional<T>();
+      }
+      return value;
+    }
+
+    template <class T>
+    T get(UrlViewType keyStr, T defaultValue) const
+    {
+      return get<T>(keyStr).get_value_or(defaultValue);
+    }
+
+    // pick first occurrence of value
+    QueryItemIteratorType findValue(UrlViewType valueStr) const
     {
       for (auto item = std::begin(*this); item != std::end(*this); ++item)
       {
-        if (item->key.compare(keyStr) == 0)
+        if (item->value.size() == valueStr.size() && valueStr.compare(item->value) == 0)
         {
           return item;
         }
@@ -128,53 +390,2036 @@ namespace uri_parser
       return ContainerType::end();
     }
 
-    // pick first occurrence of value
-    QueryItemIteratorType findValue(UrlReturnType valueStr) const
+    // Every way to reach the items for writing (non-const element access,
+    // iterators, modifiers) drops the index, and lookups scan from then on:
+    // std::sort or key edits can not leave a stale index behind. Call this
+    // once the edits are done to have the next lookup build the index again.
+    // References and iterators taken for writing before must not be used
+    // afterwards, and neither may the query be edited through its vector base.
+    void ResetIndex()
     {
-      for (auto item = std::begin(*this); item != std::end(*this); ++item)
+      indexedSize_ = 0;
+      autoIndex_ = true;
+    }
+
+    // Builds the index up front, lookups only read afterwards. Queries shared
+    // between threads have to be prepared like this.
+    void PrepareIndex() const
+    {
+      if (ContainerType::size() >= kIndexThreshold && indexedSize_ != ContainerType::size())
+      {
+        BuildIndex();
+      }
+    }
+
+    typename ContainerType::const_iterator begin() const { return ContainerType::begin(); }
+    typename ContainerType::const_iterator end() const { return ContainerType::end(); }
+    typename ContainerType::const_reverse_iterator rbegin() const { return ContainerType::rbegin(); }
+    typename ContainerType::const_reverse_iterator rend() const { return ContainerType::rend(); }
+    typename ContainerType::const_reference operator[](std::size_t idx) const { return ContainerType::operator[](idx); }
+    typename ContainerType::const_reference at(std::size_t idx) const { return ContainerType::at(idx); }
+    typename ContainerType::const_reference front() const { return ContainerType::front(); }
+    typename ContainerType::const_reference back() const { return ContainerType::back(); }
+    const UriQueryItem<UrlReturnType>* data() const { return ContainerType::data(); }
+
+    typename ContainerType::iterator begin() { DropIndex(); return ContainerType::begin(); }
+    typename ContainerType::iterator end() { DropIndex(); return ContainerType::end(); }
+    typename ContainerType::reverse_iterator rbegin() { DropIndex(); return ContainerType::rbegin(); }
+    typename ContainerType::reverse_iterator rend() { DropIndex(); return ContainerType::rend(); }
+    typename ContainerType::reference operator[](std::size_t idx) { DropIndex(); return ContainerType::operator[](idx); }
+    typename ContainerType::reference at(std::size_t idx) { DropIndex(); return ContainerType::at(idx); }
+    typename ContainerType::reference front() { DropIndex(); return ContainerType::front(); }
+    typename ContainerType::reference back() { DropIndex(); return ContainerType::back(); }
+    UriQueryItem<UrlReturnType>* data() { DropIndex(); return ContainerType::data(); }
+
+    void push_back(const UriQueryItem<UrlReturnType>& item) { DropIndex(); ContainerType::push_back(item); }
+    void push_back(UriQueryItem<UrlReturnType>&& item) { DropIndex(); ContainerType::push_back(std::move(item)); }
+    void pop_back() { DropIndex(); ContainerType::pop_back(); }
+    void clear() { DropIndex(); ContainerType::clear(); }
+    void swap(UriQuery& other) { DropIndex(); other.DropIndex(); ContainerType::swap(other); }
+
+    template <class... Args>
+    void emplace_back(Args&&... args) { DropIndex(); ContainerType::emplace_back(std::forward<Args>(args)...); }
+
+    template <class... Args>
+    typename ContainerType::iterator emplace(Args&&... args) { DropIndex(); return ContainerType::emplace(std::forward<Args>(args)...); }
+
+    template <class... Args>
+    typename ContainerType::iterator insert(Args&&... args) { DropIndex(); return ContainerType::insert(std::forward<Args>(args)...); }
+
+    template <class... Args>
+    typename ContainerType::iterator erase(Args&&... args) { DropIndex(); return ContainerType::erase(std::forward<Args>(args)...); }
+
+    template <class... Args>
+    void resize(Args&&... args) { DropIndex(); ContainerType::resize(std::forward<Args>(args)...); }
+
+    template <class... Args>
+    void assign(Args&&... args) { DropIndex(); ContainerType::assign(std::forward<Args>(args)...); }
+
+  private:
+    static const std::uint32_t kNoItem = 0xFFFFFFFF;
+
+    // Open addressing with linear probing, one slot per distinct key.
+    // Items with the same key are chained through nextSameKey_ in query order.
+    struct KeySlot
+    {
+      std::uint32_t hash;
+      std::uint32_t first;
+      std::uint32_t last;
+    };
+
+    std::uint32_t NextWithSameKey(std::uint32_t item) const
+    {
+      const UrlReturnType& key = (*this)[item].key;
+      if (indexedSize_ == ContainerType::size())
       {
-        if (item->value.compare(valueStr) == 0)
+        // the key is checked all the same, a wrong item is never handed out
+        const std::uint32_t next = nextSameKey_[item];
+        if (next == kNoItem || (*this)[next].key == key)
         {
-          return item;
+          return next;
         }
       }
-      return ContainerType::end();
+      for (std::size_t idx = item + 1; idx < ContainerType::size(); ++idx)
+      {
+        if ((*this)[idx].key == key)
+        {
+          return static_cast<std::uint32_t>(idx);
+        }
+      }
+      return kNoItem;
+    }
+
+    std::uint32_t FindFirst(UrlViewType keyStr) const
+    {
+      if (ContainerType::size() < kIndexThreshold || (indexedSize_ != ContainerType::size() && !autoIndex_))
+      {
+        for (std::size_t idx = 0; idx < ContainerType::size(); ++idx)
+        {
+          const UrlReturnType& key = (*this)[idx].key;
+          if (key.size() == keyStr.size() && keyStr.compare(key) == 0)
+          {
+            return static_cast<std::uint32_t>(idx);
+          }
+        }
+        return kNoItem;
+      }
+
+      if (indexedSize_ != ContainerType::size())
+      {
+        BuildIndex();
+      }
+
+      const std::uint32_t hash = static_cast<std::uint32_t>(internal::HashQueryKey(keyStr.data(), keyStr.size()));
+      const std::size_t mask = slots_.size() - 1;
+      for (std::size_t slot = hash & mask; slots_[slot].first != kNoItem; slot = (slot + 1) & mask)
+      {
+        if (slots_[slot].hash == hash && keyStr.compare((*this)[slots_[slot].first].key) == 0)
+        {
+          return slots_[slot].first;
+        }
+      }
+      return kNoItem;
+    }
+
+    void DropIndex()
+    {
+      indexedSize_ = 0;
+      autoIndex_ = false;
+    }
+
+    void BuildIndex() const
+    {
+      const std::size_t itemCount = ContainerType::size();
+      std::size_t capacity = 2;
+      while (capacity < itemCount * 2)
+      {
+        capacity *= 2;
+      }
+      const KeySlot emptySlot = {0, kNoItem, kNoItem};
+      slots_.assign(capacity, emptySlot);
+      nextSameKey_.assign(itemCount, kNoItem);
+
+      const std::size_t mask = capacity - 1;
+      for (std::size_t idx = 0; idx < itemCount; ++idx)
+      {
+        const UrlReturnType& key = (*this)[idx].key;
+        const std::uint32_t hash = static_cast<std::uint32_t>(internal::HashQueryKey(key.data(), key.size()));
+        std::size_t slot = hash & mask;
+        while (slots_[slot].first != kNoItem
+          && (slots_[slot].hash != hash || (*this)[slots_[slot].first].key != key))
+        {
+          slot = (slot + 1) & mask;
+        }
+
+        KeySlot& keySlot = slots_[slot];
+        if (keySlot.first == kNoItem)
+        {
+          keySlot.hash = hash;
+          keySlot.first = static_cast<std::uint32_t>(idx);
+        }
+        else
+        {
+          nextSameKey_[keySlot.last] = static_cast<std::uint32_t>(idx);
+        }
+        keySlot.last = static_cast<std::uint32_t>(idx);
+      }
+      indexedSize_ = itemCount;
     }
+
+    mutable std::vector<KeySlot> slots_;
+    mutable std::vector<std::uint32_t> nextSameKey_;
+    mutable std::size_t indexedSize_;
+    bool autoIndex_;
   };
 
-  // free helper functions
-  template <class UrlTextType, class UrlReturnType>
-  bool UnescapeString(
-    UrlTextType srcStrBegin,
-    UrlReturnType& retVal,
-    bool plusToSpace = true,
-    UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  template <class UrlReturnType>
+  const std::size_t UriQuery<UrlReturnType>::kIndexThreshold;
+
+  template <class UrlReturnType>
+  const std::uint32_t UriQuery<UrlReturnType>::kNoItem;
+
+  namespace internal
   {
-    typedef typename internal::base_const_ptr<UrlTextType>::type(*uriUnescapeInPlaceEx)
-      (typename internal::base_ptr<UrlTextType>::type, UriBool, UriBreakConversion);
+    template <class CharType>
+    int HexDigitValue(CharType ch)
+    {
+      static const signed char values[128] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+      };
+      const auto code = static_cast<typename std::make_unsigned<CharType>::type>(ch);
+      return code < 128 ? values[code] : -1;
+    }
 
-    UrlReturnType reslt(srcStrBegin);
+    // Decodes one character at pos the way uriUnescapeInPlaceEx does with URI_BR_DONT_TOUCH:
+    // broken %-groups stay as they are
+    template <class CharType>
+    CharType DecodeQueryChar(const CharType*& pos, const CharType* afterLast, bool plusToSpace)
+    {
+      const CharType ch = *pos++;
+      if (ch == '+' && plusToSpace)
+      {
+        return ' ';
+      }
+      if (ch == '%' && afterLast - pos >= 2)
+      {
+        const int high = HexDigitValue(pos[0]);
+        const int low = HexDigitValue(pos[1]);
+        if (high >= 0 && low >= 0)
+        {
+          pos += 2;
+          return static_cast<CharType>(high * 16 + low);
+        }
+      }
+      return ch;
+    }
 
-    if (reslt.empty())
+    template <class CharType>
+    bool NeedsUnescaping(boost::basic_string_view<CharType> text, bool plusToSpace)
     {
+      for (auto ch : text)
+      {
+        if (ch == '%' || (ch == '+' && plusToSpace))
+        {
+          return true;
+        }
+      }
       return false;
     }
 
-    auto uriUnescapeInPlaceExProc =
-      std::is_convertible<UrlTextType, const char*>::value ?
-      (uriUnescapeInPlaceEx)&uriUnescapeInPlaceExA : (uriUnescapeInPlaceEx)&uriUnescapeInPlaceExW;
+    // Compares the unescaped form of escaped with plain without building it
+    template <class CharType>
+    bool UnescapedEquals(boost::basic_string_view<CharType> escaped, boost::basic_string_view<CharType> plain, bool plusToSpace)
+    {
+      // unescaping never makes text longer
+      if (escaped.size() < plain.size())
+      {
+        return false;
+      }
+      const CharType* pos = escaped.data();
+      const CharType* afterLast = pos + escaped.size();
+      for (auto ch : plain)
+      {
+        if (pos == afterLast || DecodeQueryChar(pos, afterLast, plusToSpace) != ch)
+        {
+          return false;
+        }
+      }
+      return pos == afterLast;
+    }
+
+    // Next '%' (or '+' with plusToSpace) in [pos, afterLast), afterLast if none
+    template <class CharType>
+    const CharType* FindUnescapeStop(const CharType* pos, const CharType* afterLast, bool plusToSpace)
+    {
+      if (!plusToSpace)
+      {
+        const CharType* percent = std::char_traits<CharType>::find(pos, afterLast - pos, static_cast<CharType>('%'));
+        return percent != nullptr ? percent : afterLast;
+      }
+      while (pos != afterLast && *pos != '%' && *pos != '+')
+      {
+        ++pos;
+      }
+      return pos;
+    }
+
+#if defined(CPP_URIPARSER_AVX2) || defined(CPP_URIPARSER_SSE2)
+    inline const char* FindUnescapeStop(const char* pos, const char* afterLast, bool plusToSpace)
+    {
+      if (!plusToSpace)
+      {
+        const void* percent = std::memchr(pos, '%', afterLast - pos);
+        return percent != nullptr ? static_cast<const char*>(percent) : afterLast;
+      }
+      const __m128i percent = _mm_set1_epi8('%');
+      const __m128i plus = _mm_set1_epi8('+');
+      for (; afterLast - pos >= 16; pos += 16)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        const unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, percent), _mm_cmpeq_epi8(block, plus)));
+        if (mask != 0)
+        {
+          return pos + LowestBit(mask);
+        }
+      }
+      while (pos != afterLast && *pos != '%' && *pos != '+')
+      {
+        ++pos;
+      }
+      return pos;
+    }
+#endif
+
+    // uriUnescapeInPlaceEx over [read, afterLast): runs between '%' / '+' are
+    // moved as a whole. write may equal read, decoding never writes ahead of
+    // reading. NUL is an ordinary character here. Unless final, a '%' group cut
+    // off by afterLast that could still turn out valid is left unread; read
+    // ends there and the end of the output is returned.
+    template <class CharType>
+    CharType* UnescapeChunk(const CharType*& read, const CharType* afterLast, CharType* write,
+      bool plusToSpace, UriBreakConversion breakConversion, bool& prevWasCr, bool final)
+    {
+      while (read != afterLast)
+      {
+        // escapes often come in groups, only search when the next one is not adjacent
+        if (*read != '%' && (*read != '+' || !plusToSpace))
+        {
+          const CharType* stop = FindUnescapeStop(read + 1, afterLast, plusToSpace);
+          if (write != read)
+          {
+            std::char_traits<CharType>::move(write, read, stop - read);
+          }
+          write += stop - read;
+          read = stop;
+          prevWasCr = false;
+          if (read == afterLast)
+          {
+            break;
+          }
+        }
+
+        int high, low;
+        if (*read == '+')
+        {
+          *write++ = ' ';
+          ++read;
+          prevWasCr = false;
+        }
+        else if (afterLast - read < 3 && !final && (afterLast - read == 1 || HexDigitValue(read[1]) >= 0))
+        {
+          break;
+        }
+        else if (afterLast - read < 3 || (high = HexDigitValue(read[1])) < 0 || (low = HexDigitValue(read[2])) < 0)
+        {
+          // broken %-group, the characters after '%' are looked at again
+          *write++ = *read++;
+          prevWasCr = false;
+        }
+        else
+        {
+          const int code = high * 16 + low;
+          read += 3;
+          if (code == 10)
+          {
+            switch (breakConversion)
+            {
+            case URI_BR_TO_LF:
+              if (!prevWasCr)
+              {
+                *write++ = '\n';
+              }
+              break;
+            case URI_BR_TO_CRLF:
+              if (!prevWasCr)
+              {
+                *write++ = '\r';
+                *write++ = '\n';
+              }
+              break;
+            case URI_BR_TO_CR:
+              if (!prevWasCr)
+              {
+                *write++ = '\r';
+              }
+              break;
+            default:
+              *write++ = '\n';
+            }
+            prevWasCr = false;
+          }
+          else if (code == 13)
+          {
+            switch (breakConversion)
+            {
+            case URI_BR_TO_LF:
+              *write++ = '\n';
+              break;
+            case URI_BR_TO_CRLF:
+              *write++ = '\r';
+              *write++ = '\n';
+              break;
+            default:
+              *write++ = '\r';
+            }
+            prevWasCr = true;
+          }
+          else
+          {
+            *write++ = static_cast<CharType>(code);
+            prevWasCr = false;
+          }
+        }
+      }
+      return write;
+    }
+
+    // UnescapeChunk over all of [first, afterLast), returns the decoded length
+    template <class CharType>
+    std::size_t UnescapeRange(const CharType* first, const CharType* afterLast, CharType* out,
+      bool plusToSpace, UriBreakConversion breakConversion)
+    {
+      bool prevWasCr = false;
+      return UnescapeChunk(first, afterLast, out, plusToSpace, breakConversion, prevWasCr, true) - out;
+    }
+
+    template <class CharType>
+    std::basic_string<CharType> UnescapeQueryPart(boost::basic_string_view<CharType> escaped, bool plusToSpace)
+    {
+      std::basic_string<CharType> result(escaped.data(), escaped.size());
+      if (NeedsUnescaping(escaped, plusToSpace))
+      {
+        result.resize(UnescapeRange(escaped.data(), escaped.data() + escaped.size(), &result[0], plusToSpace, URI_BR_DONT_TOUCH));
+      }
+      return result;
+    }
+  } // namespace internal
+
+  template <class T, class CharType>
+  struct UriQueryValueConverter<T, CharType, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+  {
+    static bool Convert(boost::basic_string_view<CharType> text, T& out)
+    {
+      auto pos = text.begin();
+      const bool negative = pos != text.end() && *pos == '-';
+      if (negative)
+      {
+        if (!std::is_signed<T>::value)
+        {
+          return false;
+        }
+        ++pos;
+      }
+      if (pos == text.end())
+      {
+        return false;
+      }
+
+      // accumulate towards the sign so the minimum value fits too
+      const T limit = negative ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+      T value = 0;
+      for (; pos != text.end(); ++pos)
+      {
+        if (*pos < '0' || *pos > '9')
+        {
+          return false;
+        }
+        const T digit = static_cast<T>(*pos - '0');
+        if (negative)
+        {
+          if (value < (limit + digit) / 10)
+          {
+            return false;
+          }
+          value = static_cast<T>(value * 10 - digit);
+        }
+        else
+        {
+          if (value > (limit - digit) / 10)
+          {
+            return false;
+          }
+          value = static_cast<T>(value * 10 + digit);
+        }
+      }
+      out = value;
+      return true;
+    }
+  };
 
-    auto newStringEnd = uriUnescapeInPlaceExProc(
-      &reslt.front(),
-      plusToSpace ? URI_TRUE : URI_FALSE,
-      breakConversion);
+  template <class T, class CharType>
+  struct UriQueryValueConverter<T, CharType, typename std::enable_if<std::is_floating_point<T>::value>::type>
+  {
+    // Plain decimal notation only: -?digits[.digits][(e|E)[+|-]digits], strtod
+    // would also take spaces, hex, inf & nan. While mantissa and power of ten
+    // are exact in T (15 digits and 1e22 for double, 7 and 1e10 for float) one
+    // multiplication or division in T rounds correctly without strtod.
+    static bool Convert(boost::basic_string_view<CharType> text, T& out)
+    {
+      std::size_t idx = 0;
+      const bool negative = !text.empty() && text[0] == '-';
+      if (negative)
+      {
+        ++idx;
+      }
 
-    if (newStringEnd == nullptr)
+      std::uint64_t mantissa = 0;
+      int significant = 0;
+      int exponent = 0;
+      bool digits = false;
+      for (; idx < text.size() && IsDigit(text[idx]); ++idx)
+      {
+        digits = true;
+        AddDigit(text[idx], mantissa, significant, exponent);
+      }
+      if (idx < text.size() && text[idx] == '.')
+      {
+        for (++idx; idx < text.size() && IsDigit(text[idx]); ++idx)
+        {
+          digits = true;
+          AddDigit(text[idx], mantissa, significant, exponent);
+          --exponent;
+        }
+      }
+      if (!digits)
+      {
+        return false;
+      }
+
+      if (idx < text.size() && (text[idx] == 'e' || text[idx] == 'E'))
+      {
+        ++idx;
+        const bool negativeExponent = idx < text.size() && text[idx] == '-';
+        if (idx < text.size() && (text[idx] == '-' || text[idx] == '+'))
+        {
+          ++idx;
+        }
+        if (idx == text.size())
+        {
+          return false;
+        }
+        int written = 0;
+        for (; idx < text.size() && IsDigit(text[idx]); ++idx)
+        {
+          written = written < 100000 ? written * 10 + (text[idx] - '0') : written;
+        }
+        exponent += negativeExponent ? -written : written;
+      }
+      if (idx != text.size())
+      {
+        return false;
+      }
+
+      static const T kPowers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+      const bool narrow = std::numeric_limits<T>::digits < 53;
+      const int exactDigits = narrow ? 7 : 15;
+      const int exactPower = narrow ? 10 : 22;
+      if (mantissa == 0 || (significant <= exactDigits && exponent >= -exactPower && exponent <= exactPower))
+      {
+        T value = static_cast<T>(mantissa);
+        if (mantissa != 0)
+        {
+          value = exponent < 0 ? value / kPowers[-exponent] : value * kPowers[exponent];
+        }
+        out = negative ? -value : value;
+        return true;
+      }
+      return ConvertSlow(text, out);
+    }
+
+  private:
+    static bool IsDigit(CharType ch)
+    {
+      return ch >= '0' && ch <= '9';
+    }
+
+    static void AddDigit(CharType ch, std::uint64_t& mantissa, int& significant, int& exponent)
+    {
+      if (significant >= 19)
+      {
+        // beyond uint64 precision, only the magnitude counts (strtod takes over)
+        ++exponent;
+        ++significant;
+        return;
+      }
+      mantissa = mantissa * 10 + static_cast<unsigned>(ch - '0');
+      if (mantissa != 0)
+      {
+        ++significant;
+      }
+    }
+
+    // strtof / strtod / strtold, so that T is rounded to only once
+    static float ParseC(const char* text, char** end, const float*) { return std::strtof(text, end); }
+    static double ParseC(const char* text, char** end, const double*) { return std::strtod(text, end); }
+    static long double ParseC(const char* text, char** end, const long double*) { return std::strtold(text, end); }
+
+    static bool ConvertSlow(boost::basic_string_view<CharType> text, T& out)
+    {
+      // most values fit on the stack, long (zero padded) ones go to the heap
+      char stackBuffer[64];
+      std::vector<char> heapBuffer;
+      char* buffer = stackBuffer;
+      if (text.size() >= sizeof(stackBuffer))
+      {
+        heapBuffer.resize(text.size() + 1);
+        buffer = heapBuffer.data();
+      }
+
+      // strtod follows the C locale's decimal point
+      const char decimalPoint = *localeconv()->decimal_point;
+      for (std::size_t idx = 0; idx < text.size(); ++idx)
+      {
+        buffer[idx] = text[idx] == '.' ? decimalPoint : static_cast<char>(text[idx]);
+      }
+      buffer[text.size()] = 0;
+
+      char* end = nullptr;
+      const T value = ParseC(buffer, &end, static_cast<const T*>(nullptr));
+      if (end != buffer + text.size() || std::isinf(value))
+      {
+        return false;
+      }
+      out = value;
+      return true;
+    }
+  };
+
+  template <class CharType>
+  struct UriQueryValueConverter<bool, CharType>
+  {
+    static bool Convert(boost::basic_string_view<CharType> text, bool& out)
+    {
+      if (text.size() == 1 && (text[0] == '1' || text[0] == '0'))
+      {
+        out = text[0] == '1';
+        return true;
+      }
+      if (EqualsIgnoreCase(text, "true"))
+      {
+        out = true;
+        return true;
+      }
+      if (EqualsIgnoreCase(text, "false"))
+      {
+        out = false;
+        return true;
+      }
+      return false;
+    }
+
+  private:
+    static bool EqualsIgnoreCase(boost::basic_string_view<CharType> text, const char* word)
+    {
+      std::size_t idx = 0;
+      for (; idx < text.size() && word[idx] != 0; ++idx)
+      {
+        const CharType ch = (text[idx] >= 'A' && text[idx] <= 'Z') ? static_cast<CharType>(text[idx] - 'A' + 'a') : text[idx];
+        if (ch != word[idx])
+        {
+          return false;
+        }
+      }
+      return idx == text.size() && word[idx] == 0;
+    }
+  };
+
+  namespace internal
+  {
+    // Unescapes into a stack buffer only when there is something to unescape
+    template <class T, class CharType>
+    boost::optional<T> ConvertQueryValue(boost::basic_string_view<CharType> raw, bool plusToSpace)
+    {
+      T value;
+      if (!NeedsUnescaping(raw, plusToSpace))
+      {
+        return UriQueryValueConverter<T, CharType>::Convert(raw, value) ? boost::optional<T>(value) : boost::optional<T>();
+      }
+
+      CharType buffer[128];
+      if (raw.size() > sizeof(buffer) / sizeof(buffer[0]))
+      {
+        const std::basic_string<CharType> unescaped = UnescapeQueryPart(raw, plusToSpace);
+        return UriQueryValueConverter<T, CharType>::Convert(unescaped, value) ? boost::optional<T>(value) : boost::optional<T>();
+      }
+
+      const std::size_t size = UnescapeRange(raw.data(), raw.data() + raw.size(), buffer, plusToSpace, URI_BR_DONT_TOUCH);
+      return UriQueryValueConverter<T, CharType>::Convert(boost::basic_string_view<CharType>(buffer, size), value)
+        ? boost::optional<T>(value) : boost::optional<T>();
+    }
+
+    // unreserved characters are never escaped, '%' and '+' mean something already
+    constexpr bool IsQuerySeparatorChar(char ch)
+    {
+      return !((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+        || ch == '-' || ch == '.' || ch == '_' || ch == '~' || ch == '%' || ch == '+');
+    }
+  } // namespace internal
+
+  // Pair & key/value separators of a query, fixed at compile time so the
+  // splitting loops compare against constants. QueryBuilder escapes every
+  // reserved character, so any of them works as a separator.
+  template <char PairSeparator, char KeyValueSeparator = '='>
+  struct QuerySeparators
+  {
+    static_assert(PairSeparator != KeyValueSeparator, "query separators have to differ");
+    static_assert(internal::IsQuerySeparatorChar(PairSeparator) && internal::IsQuerySeparatorChar(KeyValueSeparator),
+      "query separators have to be reserved characters");
+
+    static const char kPair = PairSeparator;
+    static const char kKeyValue = KeyValueSeparator;
+  };
+
+  template <char PairSeparator, char KeyValueSeparator>
+  const char QuerySeparators<PairSeparator, KeyValueSeparator>::kPair;
+  template <char PairSeparator, char KeyValueSeparator>
+  const char QuerySeparators<PairSeparator, KeyValueSeparator>::kKeyValue;
+
+  typedef QuerySeparators<'&'> DefaultQuerySeparators; // what the C library uses
+  typedef QuerySeparators<';'> SemicolonQuerySeparators; // legacy, HTML 4 era
+  typedef QuerySeparators<'|'> PipeQuerySeparators; // '|' is no valid url character, for bare query strings
+
+  namespace internal
+  {
+    // Hands out the pairs of a query one after the other: NextPair sets where
+    // the next pair starts and ends (at its pair separator or afterLast) and
+    // its first key/value separator, nullptr if there is none. False once all
+    // pairs are handed out; a trailing pair separator opens no empty pair.
+    template <class CharType, class Separators>
+    class QuerySplitter
+    {
+    public:
+      QuerySplitter() :
+        next_(nullptr),
+        afterLast_(nullptr){}
+
+      QuerySplitter(const CharType* first, const CharType* afterLast) :
+        next_(first),
+        afterLast_(afterLast){}
+
+      bool NextPair(const CharType*& pairFirst, const CharType*& keyValueSeparator, const CharType*& pairEnd)
+      {
+        if (next_ == nullptr)
+        {
+          return false;
+        }
+        // memchr / wmemchr beat a per char loop already on short pairs
+        typedef std::char_traits<CharType> Traits;
+        pairFirst = next_;
+        pairEnd = Traits::find(next_, afterLast_ - next_, static_cast<CharType>(Separators::kPair));
+        if (pairEnd == nullptr)
+        {
+          pairEnd = afterLast_;
+        }
+        keyValueSeparator = Traits::find(pairFirst, pairEnd - pairFirst, static_cast<CharType>(Separators::kKeyValue));
+        next_ = (pairEnd != afterLast_ && pairEnd + 1 != afterLast_) ? pairEnd + 1 : nullptr;
+        return true;
+      }
+
+    private:
+      const CharType* next_;
+      const CharType* afterLast_;
+    };
+
+#if defined(CPP_URIPARSER_AVX2) || defined(CPP_URIPARSER_SSE2)
+    // char queries: every separator of a 64 byte block is marked at once
+    // (4 SSE2 or 2 AVX2 compares), pairs are then cut along the bit mask.
+    // The last partial block is loaded overlapping the one before, so nothing
+    // is read past the text; queries shorter than a block stay with memchr.
+    template <class Separators>
+    class QuerySplitter<char, Separators>
+    {
+      enum : std::size_t { kBlockSize = 64 };
+
+    public:
+      QuerySplitter() :
+        next_(nullptr),
+        afterLast_(nullptr),
+        block_(nullptr),
+        mask_(0){}
+
+      QuerySplitter(const char* first, const char* afterLast) :
+        next_(first),
+        afterLast_(afterLast),
+        block_(afterLast - first >= static_cast<std::ptrdiff_t>(kBlockSize) ? first : nullptr),
+        mask_(block_ != nullptr ? Compare(first) : 0){}
+
+      BOOST_FORCEINLINE bool NextPair(const char*& pairFirst, const char*& keyValueSeparator, const char*& pairEnd)
+      {
+        if (next_ == nullptr)
+        {
+          return false;
+        }
+        pairFirst = next_;
+        if (BOOST_LIKELY(block_ == nullptr))
+        {
+          pairEnd = static_cast<const char*>(std::memchr(next_, Separators::kPair, afterLast_ - next_));
+          if (pairEnd == nullptr)
+          {
+            pairEnd = afterLast_;
+          }
+          keyValueSeparator = static_cast<const char*>(std::memchr(pairFirst, Separators::kKeyValue, pairEnd - pairFirst));
+        }
+        else
+        {
+          keyValueSeparator = nullptr;
+          for (;;)
+          {
+            pairEnd = NextSeparator();
+            if (pairEnd == afterLast_ || *pairEnd == Separators::kPair)
+            {
+              break;
+            }
+            if (keyValueSeparator == nullptr)
+            {
+              keyValueSeparator = pairEnd;
+            }
+          }
+        }
+        next_ = (pairEnd != afterLast_ && pairEnd + 1 != afterLast_) ? pairEnd + 1 : nullptr;
+        return true;
+      }
+
+    private:
+      const char* NextSeparator()
+      {
+        while (mask_ == 0)
+        {
+          block_ += kBlockSize;
+          if (block_ >= afterLast_)
+          {
+            block_ = afterLast_;
+            return afterLast_;
+          }
+          const std::size_t remaining = afterLast_ - block_;
+          mask_ = remaining >= kBlockSize ? Compare(block_)
+            : Compare(afterLast_ - kBlockSize) >> (kBlockSize - remaining);
+        }
+        const char* found = block_ + LowestBit64(mask_);
+        mask_ &= mask_ - 1;
+        return found;
+      }
+
+      static std::uint64_t Compare(const char* text)
+      {
+        std::uint64_t mask = 0;
+#if defined(CPP_URIPARSER_AVX2)
+        const __m256i pair = _mm256_set1_epi8(Separators::kPair);
+        const __m256i keyValue = _mm256_set1_epi8(Separators::kKeyValue);
+        for (std::size_t part = 0; part < kBlockSize; part += 32)
+        {
+          const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + part));
+          const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(block, pair), _mm256_cmpeq_epi8(block, keyValue));
+          mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(matches))) << part;
+        }
+#else
+        const __m128i pair = _mm_set1_epi8(Separators::kPair);
+        const __m128i keyValue = _mm_set1_epi8(Separators::kKeyValue);
+        for (std::size_t part = 0; part < kBlockSize; part += 16)
+        {
+          const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + part));
+          const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(block, pair), _mm_cmpeq_epi8(block, keyValue));
+          mask |= static_cast<std::uint64_t>(_mm_movemask_epi8(matches)) << part;
+        }
+#endif
+        return mask;
+      }
+
+      const char* next_;
+      const char* afterLast_;
+      const char* block_; // block mask_ belongs to, nullptr for short queries
+      std::uint64_t mask_; // separators of the block not handed out yet
+    };
+#endif
+  } // namespace internal
+
+  // One key=value pair of a UriQueryView, still escaped.
+  // value.data() == nullptr for keys without '='.
+  template <class CharType>
+  struct UriQueryViewItem
+  {
+    typedef boost::basic_string_view<CharType> UrlViewType;
+    typedef std::basic_string<CharType> UrlReturnType;
+
+    UrlViewType key;
+    UrlViewType value;
+    bool plusToSpace;
+
+    bool hasValue() const { return value.data() != nullptr; }
+    UrlReturnType UnescapedKey() const { return internal::UnescapeQueryPart(key, plusToSpace); }
+    UrlReturnType UnescapedValue() const { return internal::UnescapeQueryPart(value, plusToSpace); }
+  };
+
+  // Zero-copy view of a query string. Pairs are split while iterating and only
+  // unescaped on request, so looking up one parameter is a single scan without
+  // allocations. Splits like uriDissectQueryMalloc: first '=' separates, pairs
+  // with neither key nor '=' are skipped. The query text has to outlive the view.
+  // Separators picks other characters than '&' and '='.
+  template <class CharType, class Separators = DefaultQuerySeparators>
+  class UriQueryView
+  {
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+    typedef UriQueryViewItem<CharType> ItemType;
+
+    class const_iterator: public std::iterator<std::forward_iterator_tag, ItemType, std::ptrdiff_t, const ItemType*, const ItemType&>
+    {
+    public:
+      const_iterator()
+      {
+        item_.plusToSpace = true;
+      }
+
+      const_iterator(const CharType* first, const CharType* afterLast, bool plusToSpace) :
+        splitter_(first, afterLast)
+      {
+        item_.plusToSpace = plusToSpace;
+        Advance();
+      }
+
+      const ItemType& operator*() const { return item_; }
+      const ItemType* operator->() const { return &item_; }
+
+      const_iterator& operator++()
+      {
+        Advance();
+        return *this;
+      }
+
+      const_iterator operator++(int)
+      {
+        const_iterator tmp(*this);
+        Advance();
+        return tmp;
+      }
+
+      // items are told apart by where their key starts
+      bool operator==(const const_iterator& right) const { return item_.key.data() == right.item_.key.data(); }
+      bool operator!=(const const_iterator& right) const { return !operator==(right); }
+
+    private:
+      BOOST_FORCEINLINE void Advance()
+      {
+        const CharType* pairFirst;
+        const CharType* separator;
+        const CharType* pairEnd;
+        while (splitter_.NextPair(pairFirst, separator, pairEnd))
+        {
+          if (separator == nullptr)
+          {
+            if (pairFirst == pairEnd)
+            {
+              continue;
+            }
+            item_.key = UrlViewType(pairFirst, pairEnd - pairFirst);
+            item_.value = UrlViewType();
+          }
+          else
+          {
+            item_.key = UrlViewType(pairFirst, separator - pairFirst);
+            item_.value = UrlViewType(separator + 1, pairEnd - separator - 1);
+          }
+          return;
+        }
+        item_.key = UrlViewType();
+        item_.value = UrlViewType();
+      }
+
+      internal::QuerySplitter<CharType, Separators> splitter_;
+      ItemType item_;
+    };
+    typedef const_iterator iterator;
+
+    UriQueryView() :
+      plusToSpace_(true){}
+
+    explicit UriQueryView(UrlViewType query, bool plusToSpace = true) :
+      query_(query),
+      plusToSpace_(plusToSpace){}
+
+    const_iterator begin() const
+    {
+      return query_.data() == nullptr ? end() : const_iterator(query_.data(), query_.data() + query_.size(), plusToSpace_);
+    }
+    const_iterator end() const { return const_iterator(); }
+
+    bool empty() const { return begin() == end(); }
+    std::size_t size() const { return std::distance(begin(), end()); }
+
+    // First pair whose unescaped key equals key, end() if none
+    const_iterator findKey(UrlViewType key) const
+    {
+      for (auto item = begin(); item != end(); ++item)
+      {
+        if (internal::UnescapedEquals(item->key, key, plusToSpace_))
+        {
+          return item;
+        }
+      }
+      return end();
+    }
+
+    // Unescaped value of the first pair with key, none if absent
+    boost::optional<std::basic_string<CharType>> GetValue(UrlViewType key) const
+    {
+      auto item = findKey(key);
+      if (item == end())
+      {
+        return boost::optional<std::basic_string<CharType>>();
+      }
+      return item->UnescapedValue();
+    }
+
+    // Value of the first pair with key converted to T (see UriQueryValueConverter),
+    // none if the key is absent or the value does not convert
+    template <class T>
+    boost::optional<T> get(UrlViewType key) const
+    {
+      auto item = findKey(key);
+      if (item == end())
+      {
+        return boost::optional<T>();
+      }
+      return internal::ConvertQueryValue<T>(item->value, plusToSpace_);
+    }
+
+    template <class T>
+    T get(UrlViewType key, T defaultValue) const
+    {
+      return get<T>(key).get_value_or(defaultValue);
+    }
+
+    UrlViewType text() const { return query_; }
+
+  private:
+    UrlViewType query_;
+    bool plusToSpace_;
+  };
+
+  namespace internal
+  {
+    // power of two with room for twice count keys
+    constexpr std::size_t ParamTableSize(std::size_t count, std::size_t size = 4)
+    {
+      return size >= 2 * count ? size : ParamTableSize(count, size * 2);
+    }
+
+    constexpr unsigned ParamTableBits(std::size_t size, unsigned bits = 0)
+    {
+      return size == 1 ? bits : ParamTableBits(size / 2, bits + 1);
+    }
+  } // namespace internal
+
+  // Fixed set of query keys for ExtractParams, hashed once up front. Keys map
+  // by (length, first & last char) into an open addressing table of at least
+  // twice their count; the multiplier is picked so distinct signatures do not
+  // collide, so a lookup is one slot and one compare. Build it once (static)
+  // and reuse it for every url.
+  template <class CharType, std::size_t Count>
+  class QueryParamSet
+  {
+    static_assert(Count > 0 && Count < 255, "QueryParamSet holds 1 to 254 keys");
+
+    enum : std::size_t
+    {
+      kTableSize = internal::ParamTableSize(Count),
+      kTableBits = internal::ParamTableBits(kTableSize)
+    };
+
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+
+    explicit QueryParamSet(const CharType* const (&keys)[Count])
+    {
+      for (std::size_t idx = 0; idx < Count; ++idx)
+      {
+        keys_[idx] = UrlViewType(keys[idx]);
+      }
+      Build();
+    }
+
+    explicit QueryParamSet(const std::array<UrlViewType, Count>& keys) :
+      keys_(keys)
+    {
+      Build();
+    }
+
+    // Index of key in the set, size() if it is not there
+    std::size_t find(UrlViewType key) const
+    {
+      for (std::size_t slot = Slot(key); slots_[slot] != 0; slot = (slot + 1) & (kTableSize - 1))
+      {
+        const UrlViewType& candidate = keys_[slots_[slot] - 1];
+        if (candidate.size() == key.size() && std::char_traits<CharType>::compare(candidate.data(), key.data(), key.size()) == 0)
+        {
+          return slots_[slot] - 1;
+        }
+      }
+      return Count;
+    }
+
+    std::size_t size() const { return Count; }
+    const UrlViewType& operator[](std::size_t idx) const { return keys_[idx]; }
+
+    // whether a '+' in query keys (a space once decoded) can change a match
+    bool hasPlusOrSpace() const { return hasPlusOrSpace_; }
+
+  private:
+    std::size_t Slot(UrlViewType key) const
+    {
+      std::uint32_t signature = static_cast<std::uint32_t>(key.size());
+      if (!key.empty())
+      {
+        signature ^= (static_cast<std::uint32_t>(key[0]) << 8) ^ (static_cast<std::uint32_t>(key[key.size() - 1]) << 20);
+      }
+      return (signature * multiplier_) >> (32 - kTableBits);
+    }
+
+    void Build()
+    {
+      hasPlusOrSpace_ = false;
+      for (const auto& key : keys_)
+      {
+        hasPlusOrSpace_ = hasPlusOrSpace_ || std::char_traits<CharType>::find(key.data(), key.size(), ' ') != nullptr
+          || std::char_traits<CharType>::find(key.data(), key.size(), '+') != nullptr;
+      }
+
+      multiplier_ = 0x9e3779b1u;
+      for (int attempt = 0; attempt < 64; ++attempt, multiplier_ += 0x632be5a6u)
+      {
+        slots_.fill(0);
+        bool collisions = false;
+        for (std::size_t idx = 0; idx < Count; ++idx)
+        {
+          std::size_t slot = Slot(keys_[idx]);
+          for (; slots_[slot] != 0; slot = (slot + 1) & (kTableSize - 1))
+          {
+            collisions = true;
+          }
+          slots_[slot] = static_cast<std::uint8_t>(idx + 1);
+        }
+        if (!collisions)
+        {
+          return;
+        }
+      }
+      // equal signatures (or bad luck): the probing above still finds everything
+    }
+
+    std::array<UrlViewType, Count> keys_;
+    std::array<std::uint8_t, kTableSize> slots_;
+    std::uint32_t multiplier_;
+    bool hasPlusOrSpace_;
+  };
+
+  // Raw (escaped) pairs for every key of keys in a single scan over the query,
+  // first occurrence wins like findKey. Keys not in the query come back with
+  // key.data() == nullptr. Scanning stops as soon as every key is found.
+  template <class CharType, class Separators, std::size_t Count>
+  std::array<UriQueryViewItem<CharType>, Count> ExtractParams(const UriQueryView<CharType, Separators>& query,
+    const QueryParamSet<CharType, Count>& keys)
+  {
+    std::array<UriQueryViewItem<CharType>, Count> params;
+    for (auto& param : params)
+    {
+      param.key = boost::basic_string_view<CharType>();
+      param.value = boost::basic_string_view<CharType>();
+      param.plusToSpace = true;
+    }
+
+    // without a '%' in the whole query (the usual case) no key needs a second look
+    typedef std::char_traits<CharType> Traits;
+    const auto text = query.text();
+    const bool percent = !text.empty() && Traits::find(text.data(), text.size(), '%') != nullptr;
+    const bool plus = !text.empty() && keys.hasPlusOrSpace() && Traits::find(text.data(), text.size(), '+') != nullptr;
+
+    std::size_t found = 0;
+    for (auto item = query.begin(); item != query.end() && found != Count; ++item)
+    {
+      std::size_t idx = keys.find(item->key);
+      if ((percent || plus) && internal::NeedsUnescaping(item->key, item->plusToSpace))
+      {
+        // escaped key: the hash saw the raw text, compare the unescaped form
+        for (idx = 0; idx < Count && !internal::UnescapedEquals(item->key, keys[idx], item->plusToSpace); ++idx)
+        {
+        }
+      }
+      if (idx != Count && params[idx].key.data() == nullptr)
+      {
+        params[idx] = *item;
+        ++found;
+      }
+    }
+    return params;
+  }
+
+  template <class CharType, class Separators, std::size_t Count>
+  std::array<UriQueryViewItem<CharType>, Count> ExtractParams(const UriQueryView<CharType, Separators>& query,
+    const CharType* const (&keys)[Count])
+  {
+    return ExtractParams(query, QueryParamSet<CharType, Count>(keys));
+  }
+
+  // What CanonicalizeQuery keeps and in which order. Keys are matched in their
+  // unescaped form like findKey; sorting and duplicate detection compare the
+  // raw text, so normalize the url first if "%7e" and "%7E" should be one key.
+  template <class CharType>
+  class QueryCanonicalPolicy
+  {
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+
+    enum Order
+    {
+      kKeepOrder,
+      kSortByKey, // stable: equal keys stay in query order
+      kSortByKeyAndValue
+    };
+
+    enum Duplicates
+    {
+      kKeepAll,
+      kKeepFirst,
+      kKeepLast
+    };
+
+    explicit QueryCanonicalPolicy(Order order = kSortByKey, Duplicates duplicates = kKeepAll) :
+      order_(order),
+      duplicates_(duplicates),
+      allow_(false),
+      lengths_(0){}
+
+    // Keep only allowed keys; can not be mixed with Deny
+    QueryCanonicalPolicy& Allow(UrlViewType key) { return AddKey(key, true); }
+    // Drop denied keys (tracking parameters...); can not be mixed with Allow
+    QueryCanonicalPolicy& Deny(UrlViewType key) { return AddKey(key, false); }
+
+    Order order() const { return order_; }
+    Duplicates duplicates() const { return duplicates_; }
+
+    // rawKey as found in the query, escaped tells whether it has to be decoded first
+    bool Keeps(UrlViewType rawKey, bool plusToSpace, bool escaped) const
+    {
+      bool listed = false;
+      if (escaped)
+      {
+        for (const auto& key : keys_)
+        {
+          if (internal::UnescapedEquals(rawKey, UrlViewType(key), plusToSpace))
+          {
+            listed = true;
+            break;
+          }
+        }
+      }
+      else if (lengths_ & LengthBit(rawKey.size()))
+      {
+        auto key = std::lower_bound(keys_.begin(), keys_.end(), rawKey,
+          [](const std::basic_string<CharType>& lhs, UrlViewType rhs) { return UrlViewType(lhs) < rhs; });
+        listed = key != keys_.end() && UrlViewType(*key) == rawKey;
+      }
+      return listed == allow_;
+    }
+
+  private:
+    QueryCanonicalPolicy& AddKey(UrlViewType key, bool allow)
+    {
+      if (!keys_.empty() && allow_ != allow)
+      {
+        throw std::runtime_error("uriparser: query policy can not both allow and deny keys");
+      }
+      allow_ = allow;
+      auto pos = std::lower_bound(keys_.begin(), keys_.end(), key,
+        [](const std::basic_string<CharType>& lhs, UrlViewType rhs) { return UrlViewType(lhs) < rhs; });
+      if (pos == keys_.end() || UrlViewType(*pos) != key)
+      {
+        keys_.insert(pos, std::basic_string<CharType>(key.data(), key.size()));
+      }
+      lengths_ |= LengthBit(key.size());
+      return *this;
+    }
+
+    // most query keys miss the list on their length alone
+    static std::uint64_t LengthBit(std::size_t length)
+    {
+      return std::uint64_t(1) << (length < 63 ? length : 63);
+    }
+
+    Order order_;
+    Duplicates duplicates_;
+    bool allow_;
+    std::uint64_t lengths_; // bit per listed key length, 63 for longer ones
+    std::vector<std::basic_string<CharType>> keys_; // sorted
+  };
+
+  namespace internal
+  {
+    // plain data so the stack array costs nothing to set up
+    template <class CharType>
+    struct CanonicalPair
+    {
+      const CharType* key;
+      const CharType* value; // nullptr without '='
+      std::uint32_t keySize;
+      std::uint32_t valueSize;
+      std::uint32_t position;
+      bool dropped;
+      std::uint64_t prefix; // leading key chars, big-endian so it orders like compare()
+
+      boost::basic_string_view<CharType> Key() const { return boost::basic_string_view<CharType>(key, keySize); }
+      boost::basic_string_view<CharType> Value() const { return boost::basic_string_view<CharType>(value, valueSize); }
+    };
+
+    template <class CharType>
+    std::uint64_t CanonicalKeyPrefix(boost::basic_string_view<CharType> key)
+    {
+      typedef typename std::make_unsigned<CharType>::type UnsignedType;
+      const std::size_t chars = sizeof(std::uint64_t) / sizeof(CharType);
+      std::uint64_t prefix = 0;
+      for (std::size_t idx = 0; idx < chars; ++idx)
+      {
+        const std::uint64_t ch = idx < key.size() ? static_cast<UnsignedType>(key[idx]) : 0;
+        prefix = chars == 1 ? ch : (prefix << (sizeof(CharType) * 8)) | ch;
+      }
+      return prefix;
+    }
+
+    template <class CharType>
+    int CompareCanonicalKeys(const CanonicalPair<CharType>& lhs, const CanonicalPair<CharType>& rhs)
+    {
+      if (lhs.prefix != rhs.prefix)
+      {
+        return lhs.prefix < rhs.prefix ? -1 : 1;
+      }
+      return lhs.Key().compare(rhs.Key());
+    }
+
+    // functors rather than function pointers so std::sort inlines them
+    struct CanonicalKeyLess
+    {
+      template <class CharType>
+      bool operator()(const CanonicalPair<CharType>& lhs, const CanonicalPair<CharType>& rhs) const
+      {
+        const int order = CompareCanonicalKeys(lhs, rhs);
+        return order != 0 ? order < 0 : lhs.position < rhs.position;
+      }
+    };
+
+    struct CanonicalKeyValueLess
+    {
+      template <class CharType>
+      bool operator()(const CanonicalPair<CharType>& lhs, const CanonicalPair<CharType>& rhs) const
+      {
+        int order = CompareCanonicalKeys(lhs, rhs);
+        if (order == 0)
+        {
+          // a key without '=' sorts before "key="
+          const bool lhsValue = lhs.value != nullptr;
+          order = lhsValue == (rhs.value != nullptr) ? lhs.Value().compare(rhs.Value()) : (lhsValue ? 1 : -1);
+        }
+        return order != 0 ? order < 0 : lhs.position < rhs.position;
+      }
+    };
+
+    struct CanonicalPositionLess
+    {
+      template <class CharType>
+      bool operator()(const CanonicalPair<CharType>& lhs, const CanonicalPair<CharType>& rhs) const
+      {
+        return lhs.position < rhs.position;
+      }
+    };
+  } // namespace internal
+
+  // Writes the query filtered, deduplicated and ordered by policy into out and
+  // returns its length. Pairs are copied as written (no re-escaping), so the
+  // result is never longer than query.text(): out needs at most that size,
+  // std::length_error otherwise. Up to 64 pairs are ranged on the stack, only
+  // bigger queries allocate.
+  template <class CharType, class Separators>
+  std::size_t CanonicalizeQuery(const UriQueryView<CharType, Separators>& query, const QueryCanonicalPolicy<CharType>& policy,
+    CharType* out, std::size_t outSize)
+  {
+    typedef internal::CanonicalPair<CharType> PairType;
+    typedef QueryCanonicalPolicy<CharType> PolicyType;
+
+    PairType stackPairs[64];
+    const std::size_t stackCount = sizeof(stackPairs) / sizeof(stackPairs[0]);
+    std::vector<PairType> heapPairs;
+    PairType* pairs = stackPairs;
+    std::size_t count = 0;
+    const bool sorted = policy.duplicates() != PolicyType::kKeepAll || policy.order() != PolicyType::kKeepOrder;
+
+    for (auto item = query.begin(); item != query.end(); ++item)
+    {
+      if (!policy.Keeps(item->key, item->plusToSpace, internal::NeedsUnescaping(item->key, item->plusToSpace)))
+      {
+        continue;
+      }
+      if (count == stackCount)
+      {
+        heapPairs.assign(stackPairs, stackPairs + stackCount);
+      }
+      if (count >= stackCount)
+      {
+        heapPairs.push_back(PairType());
+        pairs = heapPairs.data();
+      }
+      PairType& pair = pairs[count];
+      pair.key = item->key.data();
+      pair.value = item->value.data();
+      pair.keySize = static_cast<std::uint32_t>(item->key.size());
+      pair.valueSize = static_cast<std::uint32_t>(item->value.size());
+      pair.position = static_cast<std::uint32_t>(count);
+      pair.dropped = false;
+      pair.prefix = sorted ? internal::CanonicalKeyPrefix(item->key) : 0;
+      ++count;
+    }
+
+    if (sorted)
+    {
+      if (policy.order() == PolicyType::kSortByKeyAndValue)
+      {
+        std::sort(pairs, pairs + count, internal::CanonicalKeyValueLess());
+      }
+      else
+      {
+        std::sort(pairs, pairs + count, internal::CanonicalKeyLess());
+      }
+    }
+    if (policy.duplicates() != PolicyType::kKeepAll)
+    {
+      // equal keys are adjacent now, keep the first / last of each run in query order
+      const bool keepFirst = policy.duplicates() == PolicyType::kKeepFirst;
+      std::size_t run = 0;
+      for (std::size_t idx = 1; idx <= count; ++idx)
+      {
+        if (idx == count || internal::CompareCanonicalKeys(pairs[idx], pairs[run]) != 0)
+        {
+          std::size_t keep = run;
+          for (std::size_t other = run + 1; other < idx; ++other)
+          {
+            const bool earlier = pairs[other].position < pairs[keep].position;
+            keep = earlier == keepFirst ? other : keep;
+            pairs[other].dropped = true;
+          }
+          pairs[run].dropped = true;
+          pairs[keep].dropped = false;
+          run = idx;
+        }
+      }
+      if (policy.order() == PolicyType::kKeepOrder)
+      {
+        std::sort(pairs, pairs + count, internal::CanonicalPositionLess());
+      }
+    }
+
+    // pairs still next to each other in the query are copied as one block
+    std::size_t written = 0;
+    const CharType* blockFirst = nullptr;
+    const CharType* blockLast = nullptr;
+    auto flush = [&]()
+    {
+      const std::size_t size = (written != 0 ? 1 : 0) + (blockLast - blockFirst);
+      if (outSize - written < size)
+      {
+        throw std::length_error("uriparser: canonical query buffer too small");
+      }
+      if (written != 0)
+      {
+        out[written++] = Separators::kPair;
+      }
+      written = std::copy(blockFirst, blockLast, out + written) - out;
+    };
+    for (std::size_t idx = 0; idx < count; ++idx)
+    {
+      const PairType& pair = pairs[idx];
+      if (pair.dropped)
+      {
+        continue;
+      }
+      const CharType* pairLast = pair.value != nullptr ? pair.value + pair.valueSize : pair.key + pair.keySize;
+      if (blockFirst != nullptr && pair.key == blockLast + 1 && *blockLast == Separators::kPair)
+      {
+        blockLast = pairLast;
+        continue;
+      }
+      if (blockFirst != nullptr)
+      {
+        flush();
+      }
+      blockFirst = pair.key;
+      blockLast = pairLast;
+    }
+    if (blockFirst != nullptr)
+    {
+      flush();
+    }
+    return written;
+  }
+
+  // Same into a string, reusing its capacity
+  template <class CharType, class Separators>
+  std::basic_string<CharType>& CanonicalizeQuery(const UriQueryView<CharType, Separators>& query, const QueryCanonicalPolicy<CharType>& policy,
+    std::basic_string<CharType>& out)
+  {
+    out.resize(query.text().size());
+    out.resize(out.empty() ? 0 : CanonicalizeQuery(query, policy, &out[0], out.size()));
+    return out;
+  }
+
+  namespace internal
+  {
+    // Adds to length what uriEscapeEx writes for [pos, afterLast), stops at NUL
+    // like it does and returns where counting ended
+    template <class CharType>
+    const CharType* CountEscapedLength(const CharType* pos, const CharType* afterLast,
+      bool spaceToPlus, bool normalizeBreaks, bool& prevWasCr, std::size_t& length)
+    {
+      for (; pos != afterLast && *pos != 0; ++pos)
+      {
+        const CharType ch = *pos;
+        const bool unreserved = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+          || ch == '-' || ch == '.' || ch == '_' || ch == '~';
+        if (unreserved || (ch == ' ' && spaceToPlus))
+        {
+          length += 1;
+        }
+        else if (ch == '\n' && normalizeBreaks)
+        {
+          length += prevWasCr ? 0 : 6;
+        }
+        else
+        {
+          length += (ch == '\r' && normalizeBreaks) ? 6 : 3;
+        }
+        prevWasCr = (ch == '\r');
+      }
+      return pos;
+    }
+
+    // Exact number of characters uriEscapeEx writes for [first, afterLast) (terminator not counted)
+    template <class CharType>
+    std::size_t EscapedLength(const CharType* first, const CharType* afterLast, bool spaceToPlus, bool normalizeBreaks)
+    {
+      std::size_t length = 0;
+      bool prevWasCr = false;
+      CountEscapedLength(first, afterLast, spaceToPlus, normalizeBreaks, prevWasCr, length);
+      return length;
+    }
+
+#if defined(CPP_URIPARSER_AVX2) || defined(CPP_URIPARSER_SSE2)
+    // 16 characters at a time: a block is 16 + 2 * (escaped characters) long
+    // unless it holds NUL or a character the flags treat specially, those
+    // blocks are counted one by one
+    inline std::size_t EscapedLength(const char* first, const char* afterLast, bool spaceToPlus, bool normalizeBreaks)
+    {
+      // x in [lo, hi] for ASCII bounds, bytes >= 0x80 are negative and never match
+      auto inRange = [](__m128i x, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8(hi + 1)));
+      };
+      auto sumHalves = [](__m128i x) {
+        std::uint64_t halves[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(halves), x);
+        return static_cast<std::size_t>(halves[0] + halves[1]);
+      };
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i space = spaceToPlus ? _mm_set1_epi8(' ') : zero;
+      const __m128i lineFeed = normalizeBreaks ? _mm_set1_epi8('\n') : zero;
+      const __m128i carriageReturn = normalizeBreaks ? _mm_set1_epi8('\r') : zero;
+
+      std::size_t length = 0;
+      __m128i escapedTwice = zero;
+      bool prevWasCr = false;
+      const char* pos = first;
+      for (; afterLast - pos >= 16; pos += 16)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        const __m128i special = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(block, zero), _mm_cmpeq_epi8(block, space)),
+          _mm_or_si128(_mm_cmpeq_epi8(block, lineFeed), _mm_cmpeq_epi8(block, carriageReturn)));
+        if (_mm_movemask_epi8(special) != 0)
+        {
+          if (CountEscapedLength(pos, pos + 16, spaceToPlus, normalizeBreaks, prevWasCr, length) != pos + 16)
+          {
+            return length + sumHalves(escapedTwice);
+          }
+          continue;
+        }
+
+        const __m128i letters = inRange(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z');
+        const __m128i marks = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('-')), _mm_cmpeq_epi8(block, _mm_set1_epi8('.'))),
+          _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('_')), _mm_cmpeq_epi8(block, _mm_set1_epi8('~'))));
+        const __m128i unreserved = _mm_or_si128(_mm_or_si128(letters, marks), inRange(block, '0', '9'));
+        // 2 extra characters for every escaped one, summed up per 64-bit half
+        escapedTwice = _mm_add_epi64(escapedTwice, _mm_sad_epu8(_mm_andnot_si128(unreserved, _mm_set1_epi8(2)), zero));
+        length += 16;
+        prevWasCr = false;
+      }
+      CountEscapedLength(pos, afterLast, spaceToPlus, normalizeBreaks, prevWasCr, length);
+      return length + sumHalves(escapedTwice);
+    }
+#endif
+
+    // Growable storage for BasicQueryBuilder, keeps its capacity across clear()
+    template <class CharType>
+    class QueryBuilderHeapStorage
+    {
+    public:
+      QueryBuilderHeapStorage() :
+        buffer_(1, 0){}
+
+      // worst case estimates are fine, the buffer grows anyway
+      static const bool kExactSize = false;
+
+      void reserve(std::size_t chars)
+      {
+        if (chars > buffer_.size())
+        {
+          buffer_.resize(std::max(chars, buffer_.size() * 2));
+        }
+      }
+
+      CharType* data() { return buffer_.data(); }
+      const CharType* data() const { return buffer_.data(); }
+
+    private:
+      std::vector<CharType> buffer_;
+    };
+
+    // Fixed storage for BasicQueryBuilder, e.g. on the stack. Throws once it is full
+    template <class CharType, std::size_t Size>
+    class QueryBuilderFixedStorage
+    {
+    public:
+      QueryBuilderFixedStorage()
+      {
+        buffer_[0] = 0;
+      }
+
+      // every character counts, pairs are measured before they are written
+      static const bool kExactSize = true;
+
+      void reserve(std::size_t chars)
+      {
+        if (chars > Size)
+        {
+          throw std::length_error("uriparser: query builder buffer too small");
+        }
+      }
+
+      CharType* data() { return buffer_.data(); }
+      const CharType* data() const { return buffer_.data(); }
+
+    private:
+      std::array<CharType, Size> buffer_;
+    };
+  } // namespace internal
+
+  // Composes a query string pair by pair straight into one buffer, escaping
+  // like uriComposeQueryEx does (uriEscapeEx on every key & value) but without
+  // building a UriQueryList first. The result does not start with '?'.
+  template <class CharType, class Storage = internal::QueryBuilderHeapStorage<CharType>, class Separators = DefaultQuerySeparators>
+  class BasicQueryBuilder
+  {
+    typedef internal::UriTypes<const CharType*> UriApiTypes;
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+    typedef std::basic_string<CharType> UrlReturnType;
+
+    explicit BasicQueryBuilder(bool spaceToPlus = true, bool normalizeBreaks = true) :
+      size_(0),
+      spaceToPlus_(spaceToPlus),
+      normalizeBreaks_(normalizeBreaks){}
+
+    // Room for that many escaped characters, see WorstCaseSize
+    void reserve(std::size_t chars)
+    {
+      storage_.reserve(chars + 1);
+    }
+
+    // Upper bound of what Append(key, value) adds
+    std::size_t WorstCaseSize(std::size_t keyLength, std::size_t valueLength) const
+    {
+      return 2 + (keyLength + valueLength) * (normalizeBreaks_ ? 6 : 3);
+    }
+
+    BasicQueryBuilder& Append(UrlViewType key, UrlViewType value)
+    {
+      CharType* write = AppendKey(key, &value);
+      *write++ = Separators::kKeyValue;
+      size_ = AppendEscaped(write, value) - storage_.data();
+      return *this;
+    }
+
+    // key without '=', like a UriQueryList item with a NULL value
+    BasicQueryBuilder& Append(UrlViewType key)
+    {
+      size_ = AppendKey(key, nullptr) - storage_.data();
+      return *this;
+    }
+
+    void clear()
+    {
+      size_ = 0;
+      storage_.data()[0] = 0;
+    }
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+    UrlViewType view() const { return UrlViewType(storage_.data(), size_); }
+    const CharType* c_str() const { return storage_.data(); }
+    UrlReturnType str() const { return UrlReturnType(storage_.data(), size_); }
+
+  private:
+    // Makes room for the whole pair, writes the pair separator and the key
+    CharType* AppendKey(UrlViewType key, const UrlViewType* value)
+    {
+      const std::size_t pairSize = Storage::kExactSize
+        ? (size_ != 0 ? 1 : 0) + internal::EscapedLength(key.data(), key.data() + key.size(), spaceToPlus_, normalizeBreaks_)
+          + (value != nullptr ? 1 + internal::EscapedLength(value->data(), value->data() + value->size(), spaceToPlus_, normalizeBreaks_) : 0)
+        : WorstCaseSize(key.size(), value != nullptr ? value->size() : 0);
+      storage_.reserve(size_ + pairSize + 1);
+      CharType* write = storage_.data() + size_;
+      if (size_ != 0)
+      {
+        *write++ = Separators::kPair;
+      }
+      return AppendEscaped(write, key);
+    }
+
+    CharType* AppendEscaped(CharType* write, UrlViewType text)
+    {
+      if (text.empty())
+      {
+        *write = 0;
+        return write;
+      }
+      return UriApiTypes::uriEscapeEx(text.data(), text.data() + text.size(), write,
+        spaceToPlus_ ? URI_TRUE : URI_FALSE, normalizeBreaks_ ? URI_TRUE : URI_FALSE);
+    }
+
+    Storage storage_;
+    std::size_t size_;
+    bool spaceToPlus_;
+    bool normalizeBreaks_;
+  };
+
+  typedef BasicQueryBuilder<char> QueryBuilder;
+  typedef BasicQueryBuilder<wchar_t> WQueryBuilder;
+
+  // Stack-only builder holding at most Size - 1 characters
+  template <std::size_t Size, class CharType = char, class Separators = DefaultQuerySeparators>
+  using FixedQueryBuilder = BasicQueryBuilder<CharType, internal::QueryBuilderFixedStorage<CharType, Size>, Separators>;
+
+  // free helper functions
+
+  // Exact length of uriEscapeEx output for in (terminator not counted); like
+  // uriEscapeEx, escaping stops at the first NUL
+  inline std::size_t EscapedLength(boost::string_view in, bool spaceToPlus = false, bool normalizeBreaks = false)
+  {
+    return internal::EscapedLength(in.data(), in.data() + in.size(), spaceToPlus, normalizeBreaks);
+  }
+
+  inline std::size_t EscapedLength(boost::wstring_view in, bool spaceToPlus = false, bool normalizeBreaks = false)
+  {
+    return internal::EscapedLength(in.data(), in.data() + in.size(), spaceToPlus, normalizeBreaks);
+  }
+
+  namespace internal
+  {
+    template <class CharType>
+    std::basic_string<CharType> EscapeView(boost::basic_string_view<CharType> in, bool spaceToPlus, bool normalizeBreaks)
+    {
+      const std::size_t length = EscapedLength(in.data(), in.data() + in.size(), spaceToPlus, normalizeBreaks);
+      if (length == 0)
+      {
+        return std::basic_string<CharType>();
+      }
+      // one allocation, the extra character takes uriEscapeEx's terminator
+      std::basic_string<CharType> result(length + 1, CharType());
+      UriTypes<const CharType*>::uriEscapeEx(in.data(), in.data() + in.size(), &result[0],
+        spaceToPlus ? URI_TRUE : URI_FALSE, normalizeBreaks ? URI_TRUE : URI_FALSE);
+      result.resize(length);
+      return result;
+    }
+  } // namespace internal
+
+  // uriEscapeEx into a string allocated once at the exact size
+  inline std::string Escape(boost::string_view in, bool spaceToPlus = false, bool normalizeBreaks = false)
+  {
+    return internal::EscapeView(in, spaceToPlus, normalizeBreaks);
+  }
+
+  inline std::wstring Escape(boost::wstring_view in, bool spaceToPlus = false, bool normalizeBreaks = false)
+  {
+    return internal::EscapeView(in, spaceToPlus, normalizeBreaks);
+  }
+
+  namespace internal
+  {
+    constexpr bool IsUnreservedChar(unsigned int ch)
+    {
+      return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+        || ch == '-' || ch == '.' || ch == '_' || ch == '~';
+    }
+
+    constexpr bool IsSubDelimChar(unsigned int ch)
+    {
+      return ch == '!' || ch == '$' || ch == '&' || ch == '\'' || ch == '(' || ch == ')'
+        || ch == '*' || ch == '+' || ch == ',' || ch == ';' || ch == '=';
+    }
+
+    // RFC 3986 pchar without pct-encoded
+    constexpr bool IsPathChar(unsigned int ch)
+    {
+      return IsUnreservedChar(ch) || IsSubDelimChar(ch) || ch == ':' || ch == '@';
+    }
+  } // namespace internal
+
+  // Escaping profiles: the characters a component keeps as they are (RFC 3986,
+  // section 3), Escape<Profile> percent-encodes everything else, '%' included.
+  // Unlike uriEscapeEx there is no space / line break handling and NUL is
+  // encoded like any other character.
+  struct UnreservedEscapeProfile // what uriEscapeEx keeps
+  {
+    static constexpr bool Keep(unsigned int ch) { return internal::IsUnreservedChar(ch); }
+  };
+
+  struct PathSegmentEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch) { return internal::IsPathChar(ch); }
+  };
+
+  struct PathEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch) { return internal::IsPathChar(ch) || ch == '/'; }
+  };
+
+  // query & fragment characters minus the separators and '+', which unescaping turns into ' '
+  template <class Separators = DefaultQuerySeparators>
+  struct QueryKeyEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch)
+    {
+      return (internal::IsPathChar(ch) || ch == '/' || ch == '?')
+        && ch != '+' && ch != static_cast<unsigned char>(Separators::kPair) && ch != static_cast<unsigned char>(Separators::kKeyValue);
+    }
+  };
+
+  // values are split off at the first key/value separator, later ones can stay
+  template <class Separators = DefaultQuerySeparators>
+  struct QueryValueEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch)
+    {
+      return (internal::IsPathChar(ch) || ch == '/' || ch == '?')
+        && ch != '+' && ch != static_cast<unsigned char>(Separators::kPair);
+    }
+  };
+
+  struct FragmentEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch) { return internal::IsPathChar(ch) || ch == '/' || ch == '?'; }
+  };
+
+  struct UserInfoEscapeProfile
+  {
+    static constexpr bool Keep(unsigned int ch)
+    {
+      return internal::IsUnreservedChar(ch) || internal::IsSubDelimChar(ch) || ch == ':';
+    }
+  };
+
+  namespace internal
+  {
+#define CPP_URIPARSER_PROFILE_KEEP(z, ch, Profile) Profile::Keep(ch),
+    // Profile::Keep for every byte, evaluated at compile time
+    template <class Profile>
+    struct EscapeProfileTable
+    {
+      static constexpr bool kKeep[256] = { BOOST_PP_REPEAT(256, CPP_URIPARSER_PROFILE_KEEP, Profile) };
+    };
+#undef CPP_URIPARSER_PROFILE_KEEP
+
+    template <class Profile>
+    constexpr bool EscapeProfileTable<Profile>::kKeep[256];
+
+    // characters above 0xff are encoded by their low byte, like uriEscapeExW does
+    template <class Profile, class CharType>
+    bool ProfileKeeps(CharType ch)
+    {
+      const auto code = static_cast<typename std::make_unsigned<CharType>::type>(ch);
+      return code <= 0xff && EscapeProfileTable<Profile>::kKeep[code];
+    }
+
+    template <class Profile, class CharType>
+    std::size_t ProfileEscapedLength(const CharType* first, const CharType* afterLast)
+    {
+      std::size_t length = afterLast - first;
+      for (; first != afterLast; ++first)
+      {
+        length += ProfileKeeps<Profile>(*first) ? 0 : 2;
+      }
+      return length;
+    }
+
+    template <class Profile, class CharType>
+    CharType* ProfileEscape(const CharType* first, const CharType* afterLast, CharType* out)
+    {
+      static const char hex[] = "0123456789ABCDEF";
+      for (; first != afterLast; ++first)
+      {
+        const CharType ch = *first;
+        if (ProfileKeeps<Profile>(ch))
+        {
+          *out++ = ch;
+        }
+        else
+        {
+          const auto code = static_cast<typename std::make_unsigned<CharType>::type>(ch);
+          out[0] = '%';
+          out[1] = hex[(code >> 4) & 0x0f];
+          out[2] = hex[code & 0x0f];
+          out += 3;
+        }
+      }
+      return out;
+    }
+
+    template <class Profile, class CharType>
+    std::basic_string<CharType> ProfileEscapeView(boost::basic_string_view<CharType> in)
+    {
+      std::basic_string<CharType> result(ProfileEscapedLength<Profile>(in.data(), in.data() + in.size()), CharType());
+      if (!result.empty())
+      {
+        ProfileEscape<Profile>(in.data(), in.data() + in.size(), &result[0]);
+      }
+      return result;
+    }
+  } // namespace internal
+
+  // Exact length of Escape<Profile>(in)
+  template <class Profile>
+  std::size_t EscapedLength(boost::string_view in)
+  {
+    return internal::ProfileEscapedLength<Profile>(in.data(), in.data() + in.size());
+  }
+
+  template <class Profile>
+  std::size_t EscapedLength(boost::wstring_view in)
+  {
+    return internal::ProfileEscapedLength<Profile>(in.data(), in.data() + in.size());
+  }
+
+  // Escapes in into out (room for EscapedLength<Profile>(in), at most 3 * in.size()
+  // characters), returns the written length; nothing is NUL-terminated
+  template <class Profile>
+  std::size_t EscapeInto(boost::string_view in, char* out)
+  {
+    return internal::ProfileEscape<Profile>(in.data(), in.data() + in.size(), out) - out;
+  }
+
+  template <class Profile>
+  std::size_t EscapeInto(boost::wstring_view in, wchar_t* out)
+  {
+    return internal::ProfileEscape<Profile>(in.data(), in.data() + in.size(), out) - out;
+  }
+
+  template <class Profile>
+  std::string Escape(boost::string_view in)
+  {
+    return internal::ProfileEscapeView<Profile>(in);
+  }
+
+  template <class Profile>
+  std::wstring Escape(boost::wstring_view in)
+  {
+    return internal::ProfileEscapeView<Profile>(in);
+  }
+
+
+  // Percent-decodes in into out in one pass and returns the decoded length, the
+  // way uriUnescapeInPlaceEx does but without NUL-termination: the whole view is
+  // decoded, nothing is appended. out needs room for in.size() characters and
+  // may be in.data() itself.
+  inline std::size_t Unescape(boost::string_view in, char* out,
+    bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  {
+    return internal::UnescapeRange(in.data(), in.data() + in.size(), out, plusToSpace, breakConversion);
+  }
+
+  inline std::size_t Unescape(boost::wstring_view in, wchar_t* out,
+    bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  {
+    return internal::UnescapeRange(in.data(), in.data() + in.size(), out, plusToSpace, breakConversion);
+  }
+
+  inline std::string Unescape(boost::string_view in,
+    bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  {
+    std::string result(in.size(), '\0');
+    result.resize(Unescape(in, &result[0], plusToSpace, breakConversion));
+    return result;
+  }
+
+  inline std::wstring Unescape(boost::wstring_view in,
+    bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  {
+    std::wstring result(in.size(), L'\0');
+    result.resize(Unescape(in, &result[0], plusToSpace, breakConversion));
+    return result;
+  }
+
+  // NUL-terminated text (strings end at their first NUL), false for empty text
+  template <class UrlTextType, class UrlReturnType>
+  bool UnescapeString(
+    UrlTextType srcStrBegin,
+    UrlReturnType& retVal,
+    bool plusToSpace = true,
+    UriBreakConversion breakConversion = URI_BR_DONT_TOUCH)
+  {
+    typedef typename UrlReturnType::value_type CharType;
+    boost::basic_string_view<CharType> text(srcStrBegin);
+    text = text.substr(0, text.find(CharType()));
+    if (text.empty())
     {
       return false;
     }
 
-    retVal.assign(&reslt.front());
+    retVal.resize(text.size());
+    retVal.resize(internal::UnescapeRange(text.data(), text.data() + text.size(), &retVal[0], plusToSpace, breakConversion));
+    // decoded %00 ends the string, as it always has for this helper
+    retVal.resize(std::min(retVal.size(), retVal.find(CharType())));
     return true;
   }
 
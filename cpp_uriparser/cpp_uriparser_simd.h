@@ -0,0 +1,57 @@
+#pragma once
+
+// Instruction set selection & bit helpers shared by the vectorized scanners.
+// Define CPP_URIPARSER_NO_SIMD to build the portable fallbacks only.
+
+#if defined(CPP_URIPARSER_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define CPP_URIPARSER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPP_URIPARSER_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace uri_parser
+{
+  namespace internal
+  {
+    inline unsigned int CountBits(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+      return __popcnt(mask);
+#else
+      return __builtin_popcount(mask);
+#endif
+    }
+
+    inline unsigned int LowestBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return index;
+#else
+      return __builtin_ctz(mask);
+#endif
+    }
+
+    inline unsigned int LowestBit64(unsigned long long mask)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+      unsigned long index;
+      _BitScanForward64(&index, mask);
+      return index;
+#elif defined(_MSC_VER)
+      return static_cast<unsigned int>(mask) != 0 ? LowestBit(static_cast<unsigned int>(mask))
+        : 32 + LowestBit(static_cast<unsigned int>(mask >> 32));
+#else
+      return __builtin_ctzll(mask);
+#endif
+    }
+  } // namespace internal
+} // namespace uri_parser
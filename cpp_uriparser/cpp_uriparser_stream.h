@@ -0,0 +1,197 @@
+#pragma once
+
+#include <boost/utility/string_view.hpp>
+#include <string>
+#include <algorithm>
+#include <cstddef>
+#include "cpp_uriparser.h"
+
+namespace uri_parser
+{
+  // Percent-decodes text that arrives in chunks, the way Unescape decodes it
+  // as a whole: a %XX group split between chunks and the CR state of the
+  // break conversion are carried over. Keeps at most two characters, the
+  // output goes straight to the caller's buffer.
+  template <class CharType = char>
+  class BasicStreamingUnescaper
+  {
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+
+    explicit BasicStreamingUnescaper(bool plusToSpace = true, UriBreakConversion breakConversion = URI_BR_DONT_TOUCH) :
+      pendingSize_(0),
+      prevWasCr_(false),
+      plusToSpace_(plusToSpace),
+      breakConversion_(breakConversion){}
+
+    // Upper bound of what Feed writes for a chunk of that size
+    static std::size_t WorstCaseSize(std::size_t chunkSize)
+    {
+      return chunkSize + kMaxPending;
+    }
+
+    // Decodes chunk into out (room for WorstCaseSize(chunk.size()), not
+    // overlapping chunk), returns the written length. A trailing '%' group
+    // that may still complete is held back for the next Feed or Finish.
+    std::size_t Feed(UrlViewType chunk, CharType* out)
+    {
+      const CharType* read = chunk.data();
+      const CharType* afterLast = read + chunk.size();
+      CharType* write = out;
+
+      if (pendingSize_ != 0)
+      {
+        // the held back group plus enough of the chunk to decide it
+        CharType group[kMaxPending + 2];
+        const std::size_t taken = std::min<std::size_t>(chunk.size(), 2);
+        std::char_traits<CharType>::copy(group, pending_, pendingSize_);
+        std::char_traits<CharType>::copy(group + pendingSize_, read, taken);
+
+        const CharType* groupRead = group;
+        const CharType* groupEnd = group + pendingSize_ + taken;
+        write = internal::UnescapeChunk(groupRead, groupEnd, write, plusToSpace_, breakConversion_, prevWasCr_, false);
+        if (groupRead - group < static_cast<std::ptrdiff_t>(pendingSize_))
+        {
+          // still undecided, which only happens when the chunk was all taken
+          Hold(groupRead, groupEnd);
+          return write - out;
+        }
+        // continue with whatever the group left unread, it is all chunk text
+        read += (groupRead - group) - pendingSize_;
+        pendingSize_ = 0;
+      }
+
+      write = internal::UnescapeChunk(read, afterLast, write, plusToSpace_, breakConversion_, prevWasCr_, false);
+      Hold(read, afterLast);
+      return write - out;
+    }
+
+    // Decodes chunk and appends it to out
+    void Feed(UrlViewType chunk, std::basic_string<CharType>& out)
+    {
+      const std::size_t size = out.size();
+      out.resize(size + WorstCaseSize(chunk.size()));
+      out.resize(size + Feed(chunk, &out[size]));
+    }
+
+    // Ends the text: a held back group is broken and copied as it is. out
+    // needs room for WorstCaseSize(0) characters. The unescaper is ready for
+    // the next text afterwards.
+    std::size_t Finish(CharType* out)
+    {
+      const CharType* read = pending_;
+      const std::size_t written = internal::UnescapeChunk(read, read + pendingSize_, out,
+        plusToSpace_, breakConversion_, prevWasCr_, true) - out;
+      pendingSize_ = 0;
+      prevWasCr_ = false;
+      return written;
+    }
+
+    void Finish(std::basic_string<CharType>& out)
+    {
+      CharType tail[kMaxPending];
+      out.append(tail, Finish(tail));
+    }
+
+  private:
+    enum : std::size_t { kMaxPending = 2 }; // '%' and one hex digit
+
+    void Hold(const CharType* first, const CharType* afterLast)
+    {
+      pendingSize_ = afterLast - first;
+      std::char_traits<CharType>::move(pending_, first, pendingSize_);
+    }
+
+    CharType pending_[kMaxPending];
+    std::size_t pendingSize_;
+    bool prevWasCr_;
+    bool plusToSpace_;
+    UriBreakConversion breakConversion_;
+  };
+
+  typedef BasicStreamingUnescaper<char> StreamingUnescaper;
+  typedef BasicStreamingUnescaper<wchar_t> WStreamingUnescaper;
+
+  // Escapes text that arrives in chunks like uriEscapeEx escapes it as a
+  // whole: with normalizeBreaks, a CR ending one chunk and a LF starting the
+  // next become one %0D%0A. NUL does not end the text, it is written as %00.
+  template <class CharType = char>
+  class BasicStreamingEscaper
+  {
+    typedef internal::UriTypes<const CharType*> UriApiTypes;
+  public:
+    typedef boost::basic_string_view<CharType> UrlViewType;
+
+    explicit BasicStreamingEscaper(bool spaceToPlus = false, bool normalizeBreaks = false) :
+      prevWasCr_(false),
+      spaceToPlus_(spaceToPlus),
+      normalizeBreaks_(normalizeBreaks){}
+
+    // Upper bound of what Feed writes for a chunk of that size, terminator included
+    std::size_t WorstCaseSize(std::size_t chunkSize) const
+    {
+      return chunkSize * (normalizeBreaks_ ? 6 : 3) + 1;
+    }
+
+    // Escapes chunk into out (room for WorstCaseSize(chunk.size())), returns
+    // the written length; out is NUL-terminated like uriEscapeEx leaves it
+    std::size_t Feed(UrlViewType chunk, CharType* out)
+    {
+      const CharType* read = chunk.data();
+      const CharType* afterLast = read + chunk.size();
+      CharType* write = out;
+      *write = 0;
+
+      if (read != afterLast && *read == '\n' && prevWasCr_ && normalizeBreaks_)
+      {
+        // the CR before already stands for the whole line break
+        ++read;
+      }
+      while (read != afterLast)
+      {
+        const CharType* nul = std::char_traits<CharType>::find(read, afterLast - read, CharType());
+        const CharType* segmentEnd = nul != nullptr ? nul : afterLast;
+        if (segmentEnd != read)
+        {
+          write = UriApiTypes::uriEscapeEx(read, segmentEnd, write,
+            spaceToPlus_ ? URI_TRUE : URI_FALSE, normalizeBreaks_ ? URI_TRUE : URI_FALSE);
+        }
+        if (nul == nullptr)
+        {
+          break;
+        }
+        static const CharType escapedNul[] = { '%', '0', '0', 0 };
+        std::char_traits<CharType>::copy(write, escapedNul, 4);
+        write += 3;
+        read = nul + 1;
+      }
+      if (!chunk.empty())
+      {
+        prevWasCr_ = chunk.back() == '\r';
+      }
+      return write - out;
+    }
+
+    // Escapes chunk and appends it to out
+    void Feed(UrlViewType chunk, std::basic_string<CharType>& out)
+    {
+      const std::size_t size = out.size();
+      out.resize(size + WorstCaseSize(chunk.size()));
+      out.resize(size + Feed(chunk, &out[size]));
+    }
+
+    // Ends the text, the escaper is ready for the next one afterwards
+    void Finish()
+    {
+      prevWasCr_ = false;
+    }
+
+  private:
+    bool prevWasCr_;
+    bool spaceToPlus_;
+    bool normalizeBreaks_;
+  };
+
+  typedef BasicStreamingEscaper<char> StreamingEscaper;
+  typedef BasicStreamingEscaper<wchar_t> WStreamingEscaper;
+} // namespace uri_parser
@@ -232,6 +232,27 @@ int URI_FUNC(ParseUri)(URI_TYPE(ParserState) * state,
 
 
 
+/**
+ * Parses a RFC 3986 %URI taking path segments and host data
+ * from the given arena instead of allocating them one by one.
+ * The arena must outlive the %URI; uriFreeUriMembersA only
+ * releases members that did not fit into the arena.
+ *
+ * @param state       <b>INOUT</b>: Parser state with set output %URI, must not be NULL
+ * @param first       <b>IN</b>: Pointer to the first character to parse, must not be NULL
+ * @param afterLast   <b>IN</b>: Pointer to the character after the last to parse, must not be NULL
+ * @param arena       <b>INOUT</b>: Memory to take members from, must not be NULL
+ * @return            0 on success, error code otherwise
+ *
+ * @see uriParseUriExA
+ * @see UriArena
+ */
+int URI_FUNC(ParseUriExArena)(URI_TYPE(ParserState) * state,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriArena * arena);
+
+
+
 /**
  * Frees all memory associated with the members
  * of the %URI structure. Note that the structure
@@ -767,6 +788,49 @@ void URI_FUNC(FreeQueryList)(URI_TYPE(QueryList) * queryList);
 
 
 
+/**
+ * Constructs a query list from the raw query string of a given URI
+ * using a single block of memory: all list items come first, followed
+ * by their unescaped keys and values. Pass NULL as buffer to have that
+ * block allocated (once) and release it with uriFreeQueryListBufferA.
+ * A caller-supplied buffer must be aligned for pointers and stays owned
+ * by the caller; if it is too small nothing is written, bytesRequired
+ * tells the size needed. Lists built here must not be passed to
+ * uriFreeQueryListA.
+ *
+ * @param dest              <b>OUT</b>: Output destination, NULL for an empty query
+ * @param itemCount         <b>OUT</b>: Number of items found, can be NULL
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param buffer            <b>IN</b>: Memory to build the list in, NULL to allocate it
+ * @param bufferSize        <b>IN</b>: Size of buffer in bytes, ignored for NULL buffer
+ * @param bytesRequired     <b>OUT</b>: Size of the block in bytes, can be NULL
+ * @return                  Error code or 0 on success
+ *
+ * @see uriDissectQueryMallocExA
+ * @see uriFreeQueryListBufferA
+ */
+int URI_FUNC(DissectQueryIntoBuffer)(URI_TYPE(QueryList) ** dest, int * itemCount,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		void * buffer, size_t bufferSize, size_t * bytesRequired);
+
+
+
+/**
+ * Frees a query list allocated by uriDissectQueryIntoBufferA
+ * (called with a NULL buffer).
+ *
+ * @param queryList   <b>INOUT</b>: Query list to free
+ *
+ * @see uriDissectQueryIntoBufferA
+ */
+void URI_FUNC(FreeQueryListBuffer)(URI_TYPE(QueryList) * queryList);
+
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -154,6 +154,23 @@ typedef struct UriIp6Struct {
 
 
 
+/**
+ * Holds a caller-supplied block of memory the parser carves
+ * path segments and host data from (bump allocation).
+ * The buffer must be aligned for pointers. Once exhausted
+ * the parser falls back to malloc for the remaining members.
+ * Setting <c>used</c> back to zero releases all members at once.
+ *
+ * @see uriParseUriExArenaA
+ */
+typedef struct UriArenaStruct {
+	void * buffer; /**< Start of the memory block */
+	size_t size; /**< Size of the memory block in bytes */
+	size_t used; /**< Bytes handed out so far */
+} UriArena; /**< @copydoc UriArenaStruct */
+
+
+
 /**
  * Specifies a line break conversion mode.
  */
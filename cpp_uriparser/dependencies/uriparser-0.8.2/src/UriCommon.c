@@ -64,6 +64,7 @@
 #ifndef URI_DOXYGEN
 # include <uriparser/Uri.h>
 # include "UriCommon.h"
+# include "UriParseBase.h"
 #endif
 
 
@@ -170,7 +171,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 						if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 							free((URI_CHAR *)walker->text.first);
 						}
-						free(walker);
+						uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 					} else {
 						/* Last segment */
 						if (pathOwned && (walker->text.first != walker->text.afterLast)) {
@@ -184,7 +185,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 								walker->text.first = URI_FUNC(SafeToPointTo);
 								walker->text.afterLast = URI_FUNC(SafeToPointTo);
 							} else {
-								free(walker);
+								uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 
 								uri->pathHead = NULL;
 								uri->pathTail = NULL;
@@ -237,12 +238,12 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 									if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 										free((URI_CHAR *)walker->text.first);
 									}
-									free(walker);
+									uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 
 									if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 										free((URI_CHAR *)prev->text.first);
 									}
-									free(prev);
+									uriArenaFree(uri->reserved, prev, sizeof(URI_TYPE(PathSegment)));
 
 									return URI_FALSE; /* Raises malloc error */
 								}
@@ -256,12 +257,12 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 							if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 								free((URI_CHAR *)walker->text.first);
 							}
-							free(walker);
+							uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 
 							if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 								free((URI_CHAR *)prev->text.first);
 							}
-							free(prev);
+							uriArenaFree(uri->reserved, prev, sizeof(URI_TYPE(PathSegment)));
 
 							walker = nextBackup;
 						} else {
@@ -273,7 +274,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 								if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 									free((URI_CHAR *)walker->text.first);
 								}
-								free(walker);
+								uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 							} else {
 								/* Re-use segment for "" path segment to represent trailing slash, update tail */
 								URI_TYPE(PathSegment) * const segment = walker;
@@ -289,7 +290,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 							if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 								free((URI_CHAR *)prev->text.first);
 							}
-							free(prev);
+							uriArenaFree(uri->reserved, prev, sizeof(URI_TYPE(PathSegment)));
 
 							walker = nextBackup;
 						}
@@ -307,7 +308,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 						if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 							free((URI_CHAR *)walker->text.first);
 						}
-						free(walker);
+						uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 
 						walker = anotherNextBackup;
 					}
@@ -551,7 +552,7 @@ void URI_FUNC(FixEmptyTrailSegment)(URI_TYPE(Uri) * uri) {
 			&& (uri->pathHead != NULL)
 			&& (uri->pathHead->next == NULL)
 			&& (uri->pathHead->text.first == uri->pathHead->text.afterLast)) {
-		free(uri->pathHead);
+		uriArenaFree(uri->reserved, uri->pathHead, sizeof(URI_TYPE(PathSegment)));
 		uri->pathHead = NULL;
 		uri->pathTail = NULL;
 	}
@@ -68,6 +68,96 @@
 
 
 
+#ifndef URI_ESCAPE_TABLE
+# define URI_ESCAPE_TABLE 1
+
+# if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  if defined(_MSC_VER)
+#   include <intrin.h>
+#  endif
+#  define URI_ESCAPE_SSE2 1
+# endif
+
+/* How EscapeEx treats a character below 256 */
+# define URI_ESCAPE_COPY     0 /* unreserved, copied as is */
+# define URI_ESCAPE_PERCENT  1 /* percent encoded */
+# define URI_ESCAPE_SPECIAL  2 /* NUL, space, line feed, carriage return */
+
+static const unsigned char uriEscapeClass[256] = {
+	/* 0x00 */ 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 2, 1, 1,
+	/* 0x10 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x20 */ 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1,
+	/* 0x30 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1,
+	/* 0x40 */ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0,
+	/* 0x60 */ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x70 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1,
+	/* 0x80 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x90 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xA0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xB0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xC0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xD0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xE0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0xF0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+#endif
+
+
+
+#ifdef URI_PASS_ANSI
+# define URI_ESCAPE_CLASS(c)  uriEscapeClass[(unsigned char)(c)]
+# define URI_ESCAPE_HEX       "0123456789ABCDEF"
+#else
+/* Wide characters beyond 255 have their low byte percent encoded */
+# define URI_ESCAPE_CLASS(c)  (((unsigned int)(c) <= 0xff) \
+		? uriEscapeClass[(unsigned int)(c)] : URI_ESCAPE_PERCENT)
+# define URI_ESCAPE_HEX       L"0123456789ABCDEF"
+#endif
+
+
+
+#if defined(URI_PASS_ANSI) && defined(URI_ESCAPE_SSE2)
+/* Stores 16 characters of read to write, returns a bit mask
+ * of the unreserved ones among them. Escaping 16 characters
+ * writes at least 16, so storing all of them is fine while 16
+ * are left to read - unless a NUL ends the output early: such
+ * blocks are not stored and reported as holding no unreserved
+ * characters, which leaves them to the scalar loop. */
+static unsigned int URI_FUNC(EscapeCopyBlock)(const char * read, char * write) {
+	const __m128i block = _mm_loadu_si128((const __m128i *)read);
+	const __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+	const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), block));
+	const __m128i mark = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('-')), _mm_cmpeq_epi8(block, _mm_set1_epi8('.'))),
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('_')), _mm_cmpeq_epi8(block, _mm_set1_epi8('~'))));
+	const __m128i unreserved = _mm_or_si128(_mm_or_si128(alpha, digit), mark);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128())) != 0) {
+		return 0;
+	}
+	_mm_storeu_si128((__m128i *)write, block);
+	return (unsigned int)_mm_movemask_epi8(unreserved);
+}
+
+
+
+static int URI_FUNC(EscapeLowestBit)(unsigned int mask) {
+# if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+# else
+	return __builtin_ctz(mask);
+# endif
+}
+#endif
+
+
+
 URI_CHAR * URI_FUNC(Escape)(const URI_CHAR * in, URI_CHAR * out,
 		UriBool spaceToPlus, UriBool normalizeBreaks) {
 	return URI_FUNC(EscapeEx)(in, NULL, out, spaceToPlus, normalizeBreaks);
@@ -96,100 +186,85 @@ URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
 			return write;
 		}
 
-		switch (read[0]) {
-		case _UT('\0'):
-			write[0] = _UT('\0');
-			return write;
-
-		case _UT(' '):
-			if (spaceToPlus) {
-				write[0] = _UT('+');
+		switch (URI_ESCAPE_CLASS(read[0])) {
+		case URI_ESCAPE_COPY:
+			/* Copy the whole run of ALPHA / DIGIT / "-" / "." / "_" / "~" */
+#if defined(URI_PASS_ANSI) && defined(URI_ESCAPE_SSE2)
+			if (inAfterLast != NULL) {
+				while (inAfterLast - read >= 16) {
+					const unsigned int unreserved = URI_FUNC(EscapeCopyBlock)(read, write);
+					if (unreserved != 0xffff) {
+						const int run = URI_FUNC(EscapeLowestBit)(~unreserved);
+						read += run;
+						write += run;
+						break;
+					}
+					read += 16;
+					write += 16;
+				}
+			}
+#endif
+			while (((inAfterLast == NULL) || (read < inAfterLast))
+					&& (URI_ESCAPE_CLASS(read[0]) == URI_ESCAPE_COPY)) {
+				write[0] = read[0];
 				write++;
-			} else {
+				read++;
+			}
+			prevWasCr = URI_FALSE;
+			continue;
+
+		case URI_ESCAPE_PERCENT:
+			{
+				const unsigned char code = (unsigned char)read[0];
 				write[0] = _UT('%');
-				write[1] = _UT('2');
-				write[2] = _UT('0');
+				write[1] = URI_ESCAPE_HEX[code >> 4];
+				write[2] = URI_ESCAPE_HEX[code & 0x0f];
 				write += 3;
 			}
 			prevWasCr = URI_FALSE;
 			break;
 
-		case _UT('a'): /* ALPHA */
-		case _UT('A'):
-		case _UT('b'):
-		case _UT('B'):
-		case _UT('c'):
-		case _UT('C'):
-		case _UT('d'):
-		case _UT('D'):
-		case _UT('e'):
-		case _UT('E'):
-		case _UT('f'):
-		case _UT('F'):
-		case _UT('g'):
-		case _UT('G'):
-		case _UT('h'):
-		case _UT('H'):
-		case _UT('i'):
-		case _UT('I'):
-		case _UT('j'):
-		case _UT('J'):
-		case _UT('k'):
-		case _UT('K'):
-		case _UT('l'):
-		case _UT('L'):
-		case _UT('m'):
-		case _UT('M'):
-		case _UT('n'):
-		case _UT('N'):
-		case _UT('o'):
-		case _UT('O'):
-		case _UT('p'):
-		case _UT('P'):
-		case _UT('q'):
-		case _UT('Q'):
-		case _UT('r'):
-		case _UT('R'):
-		case _UT('s'):
-		case _UT('S'):
-		case _UT('t'):
-		case _UT('T'):
-		case _UT('u'):
-		case _UT('U'):
-		case _UT('v'):
-		case _UT('V'):
-		case _UT('w'):
-		case _UT('W'):
-		case _UT('x'):
-		case _UT('X'):
-		case _UT('y'):
-		case _UT('Y'):
-		case _UT('z'):
-		case _UT('Z'):
-		case _UT('0'): /* DIGIT */
-		case _UT('1'):
-		case _UT('2'):
-		case _UT('3'):
-		case _UT('4'):
-		case _UT('5'):
-		case _UT('6'):
-		case _UT('7'):
-		case _UT('8'):
-		case _UT('9'):
-		case _UT('-'): /* "-" / "." / "_" / "~" */
-		case _UT('.'):
-		case _UT('_'):
-		case _UT('~'):
-			/* Copy unmodified */
-			write[0] = read[0];
-			write++;
+		default:
+			switch (read[0]) {
+			case _UT('\0'):
+				write[0] = _UT('\0');
+				return write;
 
-			prevWasCr = URI_FALSE;
-			break;
+			case _UT(' '):
+				if (spaceToPlus) {
+					write[0] = _UT('+');
+					write++;
+				} else {
+					write[0] = _UT('%');
+					write[1] = _UT('2');
+					write[2] = _UT('0');
+					write += 3;
+				}
+				prevWasCr = URI_FALSE;
+				break;
 
-		case _UT('\x0a'):
-			if (normalizeBreaks) {
-				if (!prevWasCr) {
+			case _UT('\x0a'):
+				if (normalizeBreaks) {
+					if (!prevWasCr) {
+						write[0] = _UT('%');
+						write[1] = _UT('0');
+						write[2] = _UT('D');
+						write[3] = _UT('%');
+						write[4] = _UT('0');
+						write[5] = _UT('A');
+						write += 6;
+					}
+				} else {
+					write[0] = _UT('%');
+					write[1] = _UT('0');
+					write[2] = _UT('A');
+					write += 3;
+				}
+				prevWasCr = URI_FALSE;
+				break;
+
+			default: /* _UT('\x0d') */
+				if (normalizeBreaks) {
 					write[0] = _UT('%');
 					write[1] = _UT('0');
 					write[2] = _UT('D');
@@ -197,44 +272,15 @@ URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
 					write[4] = _UT('0');
 					write[5] = _UT('A');
 					write += 6;
+				} else {
+					write[0] = _UT('%');
+					write[1] = _UT('0');
+					write[2] = _UT('D');
+					write += 3;
 				}
-			} else {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('A');
-				write += 3;
-			}
-			prevWasCr = URI_FALSE;
-			break;
-
-		case _UT('\x0d'):
-			if (normalizeBreaks) {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('D');
-				write[3] = _UT('%');
-				write[4] = _UT('0');
-				write[5] = _UT('A');
-				write += 6;
-			} else {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('D');
-				write += 3;
-			}
-			prevWasCr = URI_TRUE;
-			break;
-
-		default:
-			/* Percent encode */
-			{
-				const unsigned char code = (unsigned char)read[0];
-				write[0] = _UT('%');
-				write[1] = URI_FUNC(HexToLetter)(code >> 4);
-				write[2] = URI_FUNC(HexToLetter)(code & 0x0f);
-				write += 3;
+				prevWasCr = URI_TRUE;
+				break;
 			}
-			prevWasCr = URI_FALSE;
 			break;
 		}
 
@@ -450,4 +496,9 @@ const URI_CHAR * URI_FUNC(UnescapeInPlaceEx)(URI_CHAR * inout,
 
 
 
+#undef URI_ESCAPE_CLASS
+#undef URI_ESCAPE_HEX
+
+
+
 #endif
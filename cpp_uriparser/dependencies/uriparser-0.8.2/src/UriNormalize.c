@@ -71,6 +71,7 @@
 # include <uriparser/Uri.h>
 # include "UriNormalizeBase.h"
 # include "UriCommon.h"
+# include "UriParseBase.h"
 #endif
 
 
@@ -147,7 +148,7 @@ static URI_INLINE void URI_FUNC(PreventLeakage)(URI_TYPE(Uri) * uri,
 			if (walker->text.afterLast > walker->text.first) {
 				free((URI_CHAR *)walker->text.first);
 			}
-			free(walker);
+			uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 			walker = next;
 		}
 		uri->pathHead = NULL;
@@ -432,7 +433,7 @@ static URI_INLINE UriBool URI_FUNC(MakeOwner)(URI_TYPE(Uri) * uri,
 							&& (ranger->text.afterLast != NULL)
 							&& (ranger->text.afterLast > ranger->text.first)) {
 						free((URI_CHAR *)ranger->text.first);
-						free(ranger);
+						uriArenaFree(uri->reserved, ranger, sizeof(URI_TYPE(PathSegment)));
 					}
 					ranger = next;
 				}
@@ -440,7 +441,7 @@ static URI_INLINE UriBool URI_FUNC(MakeOwner)(URI_TYPE(Uri) * uri,
 				/* Kill path from walker */
 				while (walker != NULL) {
 					URI_TYPE(PathSegment) * const next = walker->next;
-					free(walker);
+					uriArenaFree(uri->reserved, walker, sizeof(URI_TYPE(PathSegment)));
 					walker = next;
 				}
 
@@ -88,3 +88,42 @@ unsigned char uriGetOctetValue(const unsigned char * digits, int digitCount) {
 
 	}
 }
+
+
+
+/* Members are handed out pointer-aligned */
+#define URI_ARENA_ALIGN sizeof(void *)
+
+
+
+/* Takes memory from the arena, falls back to malloc when
+ * there is no arena or it is exhausted */
+void * uriArenaMalloc(UriArena * arena, size_t size) {
+	size_t offset;
+	if (arena == NULL) {
+		return malloc(size);
+	}
+
+	offset = (arena->used + URI_ARENA_ALIGN - 1) & ~(URI_ARENA_ALIGN - 1);
+	if ((offset > arena->size) || (size > arena->size - offset)) {
+		return malloc(size);
+	}
+	arena->used = offset + size;
+	return (char *)arena->buffer + offset;
+}
+
+
+
+/* Only heap members are really freed; the most recent arena
+ * member is given back, others wait for the arena reset */
+void uriArenaFree(UriArena * arena, void * member, size_t size) {
+	if ((arena != NULL)
+			&& ((char *)member >= (char *)arena->buffer)
+			&& ((char *)member < (char *)arena->buffer + arena->size)) {
+		if ((char *)member + size == (char *)arena->buffer + arena->used) {
+			arena->used = (size_t)((char *)member - (char *)arena->buffer);
+		}
+		return;
+	}
+	free(member);
+}
@@ -50,6 +50,9 @@ void uriWriteQuadToDoubleByte(const unsigned char * hexDigits, int digitCount,
 		unsigned char * output);
 unsigned char uriGetOctetValue(const unsigned char * digits, int digitCount);
 
+void * uriArenaMalloc(UriArena * arena, size_t size);
+void uriArenaFree(UriArena * arena, void * member, size_t size);
+
 
 
 #endif /* URI_PARSE_BASE_H */
@@ -78,6 +78,15 @@ static UriBool URI_FUNC(AppendQueryItem)(URI_TYPE(QueryList) ** prevNext,
 		const URI_CHAR * valueFirst, const URI_CHAR * valueAfter,
 		UriBool plusToSpace, UriBreakConversion breakConversion);
 
+static const URI_CHAR * URI_FUNC(SplitQueryItem)(const URI_CHAR * first,
+		const URI_CHAR * afterLast,
+		const URI_CHAR ** keyFirst, const URI_CHAR ** keyAfter,
+		const URI_CHAR ** valueFirst, const URI_CHAR ** valueAfter);
+
+static void URI_FUNC(CopyUnescaped)(URI_CHAR * dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion);
+
 
 
 int URI_FUNC(ComposeQueryCharsRequired)(const URI_TYPE(QueryList) * queryList,
@@ -457,4 +466,161 @@ int URI_FUNC(DissectQueryMallocEx)(URI_TYPE(QueryList) ** dest, int * itemCount,
 
 
 
+/*
+ * Splits off the pair starting at first the way DissectQueryMallocEx does:
+ * the first '=' separates key and value. Returns where the next pair
+ * starts or NULL after the last one. Pairs with neither key nor '='
+ * come back with *keyFirst == NULL.
+ */
+static const URI_CHAR * URI_FUNC(SplitQueryItem)(const URI_CHAR * first,
+		const URI_CHAR * afterLast,
+		const URI_CHAR ** keyFirst, const URI_CHAR ** keyAfter,
+		const URI_CHAR ** valueFirst, const URI_CHAR ** valueAfter) {
+	const URI_CHAR * walk = first;
+
+	*keyFirst = first;
+	*keyAfter = NULL;
+	*valueFirst = NULL;
+	*valueAfter = NULL;
+
+	for (; walk < afterLast; walk++) {
+		if (*walk == _UT('&')) {
+			break;
+		}
+		if ((*walk == _UT('=')) && (*keyAfter == NULL)) {
+			*keyAfter = walk;
+			*valueFirst = walk + 1;
+		}
+	}
+
+	if (*valueFirst != NULL) {
+		*valueAfter = walk;
+	} else {
+		*keyAfter = walk;
+		if (*keyFirst == *keyAfter) {
+			*keyFirst = NULL;
+		}
+	}
+
+	return (walk + 1 < afterLast) ? walk + 1 : NULL;
+}
+
+
+
+static void URI_FUNC(CopyUnescaped)(URI_CHAR * dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	const size_t len = (size_t)(afterLast - first);
+
+	dest[len] = _UT('\0');
+	if (len > 0) {
+		memcpy(dest, first, len * sizeof(URI_CHAR));
+		URI_FUNC(UnescapeInPlaceEx)(dest, plusToSpace, breakConversion);
+	}
+}
+
+
+
+int URI_FUNC(DissectQueryIntoBuffer)(URI_TYPE(QueryList) ** dest, int * itemCount,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		void * buffer, size_t bufferSize, size_t * bytesRequired) {
+	const URI_CHAR * walk;
+	const URI_CHAR * keyFirst;
+	const URI_CHAR * keyAfter;
+	const URI_CHAR * valueFirst;
+	const URI_CHAR * valueAfter;
+	size_t count = 0;
+	size_t chars = 0;
+	size_t required;
+	URI_TYPE(QueryList) * items;
+	URI_CHAR * text;
+	size_t index = 0;
+	int nullCounter;
+	int * itemsAppended = (itemCount == NULL) ? &nullCounter : itemCount;
+
+	if ((dest == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	*dest = NULL;
+	*itemsAppended = 0;
+
+	/* Count pairs and characters, unescaping never grows the text */
+	for (walk = first; walk != NULL; ) {
+		walk = URI_FUNC(SplitQueryItem)(walk, afterLast,
+				&keyFirst, &keyAfter, &valueFirst, &valueAfter);
+		if (keyFirst == NULL) {
+			continue;
+		}
+		count++;
+		chars += (size_t)(keyAfter - keyFirst) + 1;
+		if (valueFirst != NULL) {
+			chars += (size_t)(valueAfter - valueFirst) + 1;
+		}
+	}
+
+	required = count * sizeof(URI_TYPE(QueryList)) + chars * sizeof(URI_CHAR);
+	if (bytesRequired != NULL) {
+		*bytesRequired = required;
+	}
+
+	if (count == 0) {
+		return URI_SUCCESS;
+	}
+
+	if (buffer == NULL) {
+		buffer = malloc(required);
+		if (buffer == NULL) {
+			return URI_ERROR_MALLOC;
+		}
+	} else if (bufferSize < required) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	/* Items first, then their text */
+	items = (URI_TYPE(QueryList) *)buffer;
+	text = (URI_CHAR *)(items + count);
+	for (walk = first; walk != NULL; ) {
+		walk = URI_FUNC(SplitQueryItem)(walk, afterLast,
+				&keyFirst, &keyAfter, &valueFirst, &valueAfter);
+		if (keyFirst == NULL) {
+			continue;
+		}
+
+		URI_FUNC(CopyUnescaped)(text, keyFirst, keyAfter,
+				plusToSpace, breakConversion);
+		items[index].key = text;
+		text += (keyAfter - keyFirst) + 1;
+
+		if (valueFirst != NULL) {
+			URI_FUNC(CopyUnescaped)(text, valueFirst, valueAfter,
+					plusToSpace, breakConversion);
+			items[index].value = text;
+			text += (valueAfter - valueFirst) + 1;
+		} else {
+			items[index].value = NULL;
+		}
+
+		items[index].next = (index + 1 < count) ? &items[index + 1] : NULL;
+		index++;
+	}
+
+	*dest = items;
+	*itemsAppended = (int)count;
+	return URI_SUCCESS;
+}
+
+
+
+void URI_FUNC(FreeQueryListBuffer)(URI_TYPE(QueryList) * queryList) {
+	free(queryList);
+}
+
+
+
 #endif
@@ -0,0 +1,195 @@
+#include "cpp_uriparser_batch.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+  std::vector<std::string> SegmentsOf(const uri_parser::ParsedUri<const char*>& uri)
+  {
+    std::vector<std::string> segments;
+    auto pathHead = uri.PathHead();
+    for (auto segment = std::begin(pathHead); segment != std::end(pathHead); ++segment)
+    {
+      segments.push_back(*segment);
+    }
+    return segments;
+  }
+
+  void ExpectSameUri(const uri_parser::ParsedUri<const char*>& expected, const uri_parser::ParsedUri<const char*>& actual)
+  {
+    EXPECT_EQ(expected.SchemeView(), actual.SchemeView());
+    EXPECT_EQ(expected.UserInfoView(), actual.UserInfoView());
+    EXPECT_EQ(expected.HostView(), actual.HostView());
+    EXPECT_EQ(expected.PortView(), actual.PortView());
+    EXPECT_EQ(expected.PathView(), actual.PathView());
+    EXPECT_EQ(expected.QueryView(), actual.QueryView());
+    EXPECT_EQ(expected.FragmentView(), actual.FragmentView());
+    EXPECT_EQ(expected.QueryView().data() == nullptr, actual.QueryView().data() == nullptr);
+    EXPECT_EQ(expected.FragmentView().data() == nullptr, actual.FragmentView().data() == nullptr);
+    EXPECT_EQ(expected.PortView().data() == nullptr, actual.PortView().data() == nullptr);
+    EXPECT_EQ(SegmentsOf(expected), SegmentsOf(actual));
+  }
+}
+
+TEST(cppUriParserBatch, matches_full_grammar)
+{
+  const std::vector<std::string> corpus = {
+    "http://www.example.com",
+    "http://www.example.com/",
+    "http://www.example.com//",
+    "https://www.example.com:8443/a/b/c?x=1&y=2#frag",
+    "http://host?only=query",
+    "http://host#only-fragment",
+    "http://host/a?q#f?g",
+    "http://host/a#f?notquery",
+    "http://host/with%20space/and%2Fslash",
+    "http://host/bad%2",
+    "http://host/bad%zz",
+    "http://host:/empty-port",
+    "http://host:80a/bad-port",
+    "http://user:pw@host/path",
+    "http://[::1]:80/v6",
+    "http://127.0.0.1/ip4",
+    "http://1.2.3/almost-ip4",
+    "ftp://files.example.org/pub/long/path/with/many/segments/file.tar.gz",
+    "mailto:someone@example.com",
+    "/relative/path",
+    "relative",
+    "",
+    "1http://bad-scheme/",
+    "http://host/path with space",
+    "http://host/p?q=a/b?c&d=@:",
+    "svn+ssh://repo.example.org/trunk",
+    "http://h.example/" + std::string(100, 'a') + "/" + std::string(40, 'b') + "?" + std::string(70, 'q'),
+  };
+
+  std::vector<boost::string_view> views(corpus.begin(), corpus.end());
+  uri_parser::ParsedBatch<const char*> batch;
+  uri_parser::ParseBatch(views, batch);
+  ASSERT_EQ(batch.size(), corpus.size());
+  EXPECT_GT(batch.fastPathCount(), 0u);
+
+  for (std::size_t idx = 0; idx < corpus.size(); ++idx)
+  {
+    SCOPED_TRACE(corpus[idx]);
+    const char* text = corpus[idx].c_str();
+    try
+    {
+      uri_parser::UriEntry<const char*> expected(text, text + corpus[idx].size());
+      ASSERT_EQ(batch.error(idx), URI_SUCCESS);
+      ExpectSameUri(expected, batch[idx]);
+    }
+    catch (const std::runtime_error&)
+    {
+      EXPECT_NE(batch.error(idx), URI_SUCCESS);
+    }
+  }
+}
+
+TEST(cppUriParserBatch, reusing_output)
+{
+  uri_parser::ParsedBatch<const char*> batch;
+  const boost::string_view first[] = {"http://a.example/1", "http://b.example/2/3"};
+  uri_parser::ParseBatch(first, 2, batch);
+  EXPECT_EQ(batch[1].PathView(), "/2/3");
+
+  const boost::string_view second[] = {"http://c.example/x?y"};
+  uri_parser::ParseBatch(second, 1, batch);
+  ASSERT_EQ(batch.size(), 1u);
+  EXPECT_EQ(batch[0].HostView(), "c.example");
+  EXPECT_EQ(batch[0].QueryView(), "y");
+  EXPECT_EQ(batch.fastPathCount(), 1u);
+}
+
+TEST(cppUriParserBatch, parallel_parse_keeps_input_order)
+{
+  std::vector<std::string> corpus;
+  for (int idx = 0; idx < 5000; ++idx)
+  {
+    // every 7th url needs the full grammar, every 11th is broken
+    corpus.push_back(idx % 11 == 0 ? "http://bad host/" + std::to_string(idx)
+      : idx % 7 == 0 ? "http://user@host" + std::to_string(idx) + ".example/p/" + std::to_string(idx)
+      : "https://host" + std::to_string(idx) + ".example/p/" + std::to_string(idx) + "?n=" + std::to_string(idx));
+  }
+  std::vector<boost::string_view> views(corpus.begin(), corpus.end());
+
+  auto result = uri_parser::ParallelParse(views, 4);
+  ASSERT_EQ(result.size(), corpus.size());
+  EXPECT_GT(result.chunkCount(), 1u);
+
+  for (std::size_t idx = 0; idx < corpus.size(); ++idx)
+  {
+    if (idx % 11 == 0)
+    {
+      EXPECT_NE(result.error(idx), URI_SUCCESS);
+      continue;
+    }
+    ASSERT_EQ(result.error(idx), URI_SUCCESS);
+    EXPECT_EQ(result[idx].HostView(), "host" + std::to_string(idx) + ".example");
+    EXPECT_EQ(result[idx].PathView(), "/p/" + std::to_string(idx));
+  }
+
+  auto single = uri_parser::ParallelParse(views, 1);
+  EXPECT_EQ(single[42].HostView(), result[42].HostView());
+}
+
+TEST(cppUriParserBatch, parallel_parse_reads_strings_in_place)
+{
+  // short urls live inside the string objects, long ones on the heap
+  std::vector<std::string> corpus;
+  for (int idx = 0; idx < 3000; ++idx)
+  {
+    corpus.push_back(idx % 2 == 0 ? "http://h" + std::to_string(idx % 10) + "/"
+      : "https://host" + std::to_string(idx) + ".example/some/longer/path?n=" + std::to_string(idx));
+  }
+
+  auto result = uri_parser::ParallelParse(corpus, 3);
+  ASSERT_EQ(result.size(), corpus.size());
+  for (std::size_t idx = 0; idx < corpus.size(); ++idx)
+  {
+    ASSERT_EQ(result.error(idx), URI_SUCCESS);
+    const boost::string_view host = result[idx].HostView();
+    EXPECT_EQ(host, idx % 2 == 0 ? "h" + std::to_string(idx % 10) : "host" + std::to_string(idx) + ".example");
+    EXPECT_TRUE(host.data() > corpus[idx].data() && host.data() < corpus[idx].data() + corpus[idx].size());
+  }
+
+  uri_parser::ParsedBatch<const char*> batch;
+  uri_parser::ParseBatch(corpus, batch);
+  ASSERT_EQ(batch.size(), corpus.size());
+  EXPECT_EQ(batch[1].PathView(), "/some/longer/path");
+
+  std::vector<std::wstring> wide{L"http://w.example/a", L"ftp://f/"};
+  auto wideResult = uri_parser::ParallelParse(wide, 2);
+  EXPECT_EQ(wideResult[1].HostView(), L"f");
+}
+
+TEST(cppUriParserBatch, parallel_parse_reuses_workers)
+{
+  // the same result object parses several inputs with a varying worker count
+  uri_parser::ParallelParseResult<const char*> result;
+  for (unsigned int round = 0; round < 6; ++round)
+  {
+    std::vector<std::string> corpus;
+    for (int idx = 0; idx < 3000; ++idx)
+    {
+      corpus.push_back("http://r" + std::to_string(round) + ".example/" + std::to_string(idx));
+    }
+    std::vector<boost::string_view> views(corpus.begin(), corpus.end());
+
+    result.Parse(views.data(), views.size(), 2 + round % 3);
+    ASSERT_EQ(result.size(), corpus.size());
+    for (std::size_t idx = 0; idx < corpus.size(); idx += 97)
+    {
+      ASSERT_EQ(result.error(idx), URI_SUCCESS);
+      ASSERT_EQ(result[idx].HostView(), "r" + std::to_string(round) + ".example");
+      ASSERT_EQ(result[idx].PathView(), "/" + std::to_string(idx));
+    }
+  }
+
+  // workers move along with the result
+  auto moved = std::move(result);
+  std::vector<boost::string_view> views(200, boost::string_view("http://m.example/x"));
+  moved.Parse(views.data(), views.size(), 3);
+  EXPECT_EQ(moved[199].HostView(), "m.example");
+}
@@ -1,5 +1,8 @@
 #include "cpp_uriparser.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <thread>
 
 using namespace uri_parser;
 using uri_parser::UnescapeString;
@@ -120,4 +123,692 @@ TEST(cppUriParser, traversing_through_EMPTY_query)
     ADD_FAILURE();
   }
   SUCCEED();
-}
\ No newline at end of file
+}
+TEST(cppUriParser, lazy_query_view_matches_query)
+{
+  const char* urls[] = {
+    "http://lol.wat/post?url=http://domain.tld/&title=The+title%20of&lala=1&blabla",
+    "http://h.org/?&&a=&=b&c=d=e&&f&",
+    "http://h.org/?key%3d=%3D%3d&x=%41%42",
+    "http://h.org/?",
+    "http://h.org/"
+  };
+
+  for (auto url : urls)
+  {
+    auto entry = uri_parser::UriParseUrl(url);
+    const auto& query = entry.Query();
+    auto items = entry.QueryItems();
+    ASSERT_EQ(items.size(), query.size()) << url;
+
+    auto expected = query.begin();
+    for (const auto& item : items)
+    {
+      EXPECT_EQ(item.UnescapedKey(), expected->key) << url;
+      EXPECT_EQ(item.UnescapedValue(), expected->value) << url;
+      ++expected;
+    }
+  }
+}
+
+TEST(cppUriParser, lazy_query_view_lookup)
+{
+  auto entry = uri_parser::UriParseUrl("http://h.org/?utm_source=a&utm_medium=b&q=hello+world%21&flag&sp%20ace=1");
+  auto items = entry.QueryItems();
+
+  auto q = items.findKey("q");
+  ASSERT_TRUE(q != items.end());
+  EXPECT_EQ(q->value, "hello+world%21");
+  EXPECT_EQ(q->UnescapedValue(), "hello world!");
+
+  EXPECT_EQ(items.GetValue("utm_medium").get(), "b");
+  EXPECT_EQ(items.GetValue("sp ace").get(), "1");
+  EXPECT_FALSE(items.GetValue("missing").is_initialized());
+
+  auto flag = items.findKey("flag");
+  ASSERT_TRUE(flag != items.end());
+  EXPECT_FALSE(flag->hasValue());
+  EXPECT_TRUE(items.findKey("q")->hasValue());
+
+  EXPECT_EQ(entry.QueryItems(false).findKey("q")->UnescapedValue(), "hello+world!");
+  EXPECT_TRUE(uri_parser::UriParseUrl("http://h.org/").QueryItems().empty());
+
+  // broken %-groups are kept, like uriUnescapeInPlaceEx does
+  uri_parser::UriQueryView<char> raw(boost::string_view("a=%zz%4&b=%4"));
+  EXPECT_EQ(raw.GetValue("a").get(), "%zz%4");
+  EXPECT_EQ(raw.GetValue("b").get(), "%4");
+
+  auto wideEntry = uri_parser::UriParseUrl(L"http://h.org/?k=v%20w");
+  EXPECT_EQ(wideEntry.QueryItems().GetValue(L"k").get(), L"v w");
+}
+
+TEST(cppUriParser, query_key_index)
+{
+  std::string url = "http://ads.example.com/i?";
+  for (int idx = 0; idx < 60; ++idx)
+  {
+    url += "p" + std::to_string(idx) + "=" + std::to_string(idx) + "&";
+  }
+  url += "dup=1&p7=again&dup=2&dup=3&empty=&flag";
+
+  auto entry = uri_parser::UriParseUrl(url.c_str());
+  const auto& query = entry.Query();
+  ASSERT_GE(query.size(), uri_parser::UriQuery<std::string>::kIndexThreshold);
+
+  for (int idx = 0; idx < 60; ++idx)
+  {
+    auto item = query.findKey(std::to_string(idx).insert(0, "p"));
+    ASSERT_TRUE(item != query.end());
+    EXPECT_EQ(item - query.begin(), idx);
+  }
+  EXPECT_TRUE(query.findKey("missing") == query.end());
+  EXPECT_TRUE(query.findKey(boost::string_view("flag")) != query.end());
+  EXPECT_EQ(query.findKey("empty")->value, "");
+
+  std::vector<std::string> dups;
+  auto range = query.equal_range("dup");
+  for (auto item = range.first; item != range.second; ++item)
+  {
+    dups.push_back(item->value);
+  }
+  EXPECT_EQ(dups, (std::vector<std::string>{"1", "2", "3"}));
+  EXPECT_EQ(std::distance(query.equal_range("p7").first, query.equal_range("p7").second), 2);
+  EXPECT_EQ(query.findKey("p7")->value, "7");
+  auto none = query.equal_range("nope");
+  EXPECT_TRUE(none.first == none.second);
+
+  // small queries are scanned and give the same answers
+  auto small = uri_parser::UriParseUrl("http://h.org/?a=1&b=2&a=3");
+  EXPECT_EQ(small.Query().findKey("b")->value, "2");
+  auto smallRange = small.Query().equal_range("a");
+  EXPECT_EQ(std::distance(smallRange.first, smallRange.second), 2);
+
+  // copies keep a usable index, growing the query drops it
+  auto copy = query;
+  EXPECT_EQ(copy.findKey("p59")->value, "59");
+  copy.push_back({"late", "1"});
+  EXPECT_EQ(copy.findKey("late")->value, "1");
+  EXPECT_EQ(copy.findKey("p59")->value, "59");
+  copy.ResetIndex();
+  EXPECT_EQ(copy.findKey("late")->value, "1");
+  EXPECT_EQ(std::distance(copy.equal_range("dup").first, copy.equal_range("dup").second), 3);
+}
+
+TEST(cppUriParser, query_key_index_after_edits)
+{
+  uri_parser::UriQuery<std::string> query;
+  for (int idx = 0; idx < 20; ++idx)
+  {
+    query.push_back({"k" + std::to_string(idx % 10), std::to_string(idx)});
+  }
+  query.PrepareIndex();
+  EXPECT_EQ(query.findKey("k3")->value, "3");
+
+  // same item count, every key moved
+  std::sort(query.begin(), query.end(),
+    [](const uri_parser::UriQueryItem<std::string>& left, const uri_parser::UriQueryItem<std::string>& right)
+    { return left.key > right.key || (left.key == right.key && left.value < right.value); });
+  EXPECT_EQ(query.findKey("k3") - query.cbegin(), 12);
+  EXPECT_EQ(query.findKey("k9")->value, "19");
+  std::vector<std::string> values;
+  auto range = query.equal_range("k3");
+  for (auto item = range.first; item != range.second; ++item)
+  {
+    EXPECT_EQ(item->key, "k3");
+    values.push_back(item->value);
+  }
+  EXPECT_EQ(values, (std::vector<std::string>{"13", "3"}));
+
+  // a key rewritten in place, then an erase and a push_back
+  query.ResetIndex();
+  EXPECT_EQ(query.findKey("k0")->value, "0");
+  query[19].key = "renamed";
+  EXPECT_TRUE(query.findKey("renamed") != query.cend());
+  EXPECT_EQ(query.findKey("k0")->value, "0");
+  EXPECT_EQ(query.findKey("renamed")->value, "10");
+  query.erase(query.begin());
+  query.push_back({"k9", "last"});
+  EXPECT_EQ(query.findKey("k9")->value, "9");
+  EXPECT_EQ(std::distance(query.equal_range("k9").first, query.equal_range("k9").second), 2);
+
+  // a prepared query shared const is indexed again
+  query.PrepareIndex();
+  const auto& shared = query;
+  EXPECT_EQ(shared.findKey("renamed")->value, "10");
+  EXPECT_EQ(std::distance(shared.equal_range("k1").first, shared.equal_range("k1").second), 2);
+}
+
+TEST(uriparserFreeFunctions, dissect_query_into_buffer)
+{
+  const char* queries[] = {
+    "url=http://domain.tld/&title=The+title%20of&lala=1&blabla",
+    "&&a=&=b&c=d=e&&f&",
+    "key%3d=%3D%3d&x=%41%42&br=%0D%0A",
+    "",
+    "&"
+  };
+
+  for (auto query : queries)
+  {
+    const char* afterLast = query + strlen(query);
+    UriQueryListA* expected = nullptr;
+    int expectedCount = 0;
+    ASSERT_EQ(uriDissectQueryMallocExA(&expected, &expectedCount, query, afterLast, URI_TRUE, URI_BR_TO_LF), URI_SUCCESS);
+
+    UriQueryListA* allocated = nullptr;
+    int allocatedCount = -1;
+    std::size_t required = 0;
+    ASSERT_EQ(uriDissectQueryIntoBufferA(&allocated, &allocatedCount, query, afterLast, URI_TRUE, URI_BR_TO_LF,
+      nullptr, 0, &required), URI_SUCCESS);
+    EXPECT_EQ(allocatedCount, expectedCount) << query;
+
+    // too small leaves everything untouched, the exact size is enough
+    std::vector<void*> buffer(required / sizeof(void*) + 1);
+    UriQueryListA* inBuffer = nullptr;
+    if (required > 0)
+    {
+      EXPECT_EQ(uriDissectQueryIntoBufferA(&inBuffer, nullptr, query, afterLast, URI_TRUE, URI_BR_TO_LF,
+        buffer.data(), required - 1, nullptr), URI_ERROR_OUTPUT_TOO_LARGE);
+      EXPECT_EQ(inBuffer, nullptr);
+    }
+    ASSERT_EQ(uriDissectQueryIntoBufferA(&inBuffer, nullptr, query, afterLast, URI_TRUE, URI_BR_TO_LF,
+      buffer.data(), required, nullptr), URI_SUCCESS);
+
+    const UriQueryListA* left = allocated;
+    const UriQueryListA* right = inBuffer;
+    for (const UriQueryListA* item = expected; item != nullptr; item = item->next, left = left->next, right = right->next)
+    {
+      ASSERT_TRUE(left != nullptr && right != nullptr) << query;
+      EXPECT_STREQ(left->key, item->key);
+      EXPECT_STREQ(right->key, item->key);
+      EXPECT_EQ(left->value == nullptr, item->value == nullptr);
+      if (item->value != nullptr)
+      {
+        EXPECT_STREQ(left->value, item->value);
+        EXPECT_STREQ(right->value, item->value);
+      }
+    }
+    EXPECT_EQ(left, nullptr);
+    EXPECT_EQ(right, nullptr);
+
+    uriFreeQueryListA(expected);
+    uriFreeQueryListBufferA(allocated);
+  }
+
+  const wchar_t* wideQuery = L"k=v%20w&flag";
+  UriQueryListW* wide = nullptr;
+  int wideCount = 0;
+  ASSERT_EQ(uriDissectQueryIntoBufferW(&wide, &wideCount, wideQuery, wideQuery + wcslen(wideQuery), URI_TRUE, URI_BR_DONT_TOUCH,
+    nullptr, 0, nullptr), URI_SUCCESS);
+  ASSERT_EQ(wideCount, 2);
+  EXPECT_STREQ(wide->value, L"v w");
+  EXPECT_EQ(wide->next->value, nullptr);
+  uriFreeQueryListBufferW(wide);
+}
+
+TEST(cppUriParser, query_builder_matches_compose_query)
+{
+  // same pairs through the C list + uriComposeQueryExA and through the builder
+  const char* keys[] = {"q", "with space", "amp&eq=", "empty", "flag", "br"};
+  const char* values[] = {"hello world", "a+b", "x/y?z", "", nullptr, "line\r\nnext\n"};
+  const int pairCount = sizeof(keys) / sizeof(keys[0]);
+
+  for (int mode = 0; mode < 4; ++mode)
+  {
+    const bool spaceToPlus = (mode & 1) != 0;
+    const bool normalizeBreaks = (mode & 2) != 0;
+
+    UriQueryListA items[pairCount];
+    uri_parser::QueryBuilder builder(spaceToPlus, normalizeBreaks);
+    for (int idx = 0; idx < pairCount; ++idx)
+    {
+      items[idx].key = keys[idx];
+      items[idx].value = values[idx];
+      items[idx].next = idx + 1 < pairCount ? &items[idx + 1] : nullptr;
+      if (values[idx] != nullptr)
+      {
+        builder.Append(keys[idx], values[idx]);
+      }
+      else
+      {
+        builder.Append(keys[idx]);
+      }
+    }
+
+    char expected[512];
+    int written = 0;
+    ASSERT_EQ(uriComposeQueryExA(expected, items, sizeof(expected), &written,
+      spaceToPlus ? URI_TRUE : URI_FALSE, normalizeBreaks ? URI_TRUE : URI_FALSE), URI_SUCCESS);
+    EXPECT_EQ(builder.view(), expected) << mode;
+    EXPECT_STREQ(builder.c_str(), expected);
+  }
+}
+
+TEST(cppUriParser, query_builder_storage)
+{
+  uri_parser::QueryBuilder builder;
+  builder.reserve(builder.WorstCaseSize(4, 64));
+  EXPECT_TRUE(builder.empty());
+  EXPECT_STREQ(builder.c_str(), "");
+
+  builder.Append("page", "1").Append("sort", "price asc");
+  EXPECT_EQ(builder.str(), "page=1&sort=price+asc");
+  builder.clear();
+  builder.Append("a", "");
+  EXPECT_EQ(builder.view(), "a=");
+
+  // long enough to grow a few times
+  for (int idx = 0; idx < 200; ++idx)
+  {
+    builder.Append("k", "v");
+  }
+  EXPECT_EQ(builder.size(), 2 + 200 * 4);
+
+  uri_parser::FixedQueryBuilder<16> fixed;
+  fixed.Append("id", "7");
+  EXPECT_EQ(fixed.view(), "id=7");
+  EXPECT_THROW(fixed.Append("much", "too long for the rest"), std::length_error);
+  EXPECT_EQ(fixed.view(), "id=7");
+
+  // sized exactly, line breaks included
+  uri_parser::FixedQueryBuilder<8> exact;
+  exact.Append("ab", "cd").Append("e");
+  EXPECT_EQ(exact.view(), "ab=cd&e");
+  uri_parser::FixedQueryBuilder<11> breaks;
+  breaks.Append("k", "a\r\nb");
+  EXPECT_EQ(breaks.view(), "k=a%0D%0Ab");
+
+  uri_parser::WQueryBuilder wide;
+  wide.Append(L"k", L"v w");
+  EXPECT_EQ(wide.view(), L"k=v+w");
+
+  auto entry = uri_parser::UriParseUrl(std::string("http://h.org/p?") + uri_parser::QueryBuilder().Append("q", "a&b=c").str());
+  EXPECT_EQ(entry.Query().findKey("q")->value, "a&b=c");
+}
+
+namespace
+{
+  enum class SortOrder { Ascending, Descending };
+}
+
+namespace uri_parser
+{
+  template <class CharType>
+  struct UriQueryValueConverter<SortOrder, CharType>
+  {
+    static bool Convert(boost::basic_string_view<CharType> text, SortOrder& out)
+    {
+      if (text.size() == 3 && text[0] == 'a' && text[1] == 's' && text[2] == 'c')
+      {
+        out = SortOrder::Ascending;
+        return true;
+      }
+      if (text.size() == 4 && text[0] == 'd' && text[1] == 'e' && text[2] == 's' && text[3] == 'c')
+      {
+        out = SortOrder::Descending;
+        return true;
+      }
+      return false;
+    }
+  };
+}
+
+TEST(cppUriParser, typed_query_values)
+{
+  auto entry = uri_parser::UriParseUrl("http://h.org/?limit=25&offset=-3&ratio=0.5&exp=1e3&on=TRUE&off=0"
+                                       "&big=9223372036854775807&over=9223372036854775808&low=-9223372036854775808"
+                                       "&enc=%34%32&sp=+7&bad=12a&empty=&flag&sort=desc");
+  auto items = entry.QueryItems();
+
+  EXPECT_EQ(items.get<std::int64_t>("limit").get(), 25);
+  EXPECT_EQ(items.get<int>("offset").get(), -3);
+  EXPECT_FALSE(items.get<unsigned>("offset").is_initialized());
+  EXPECT_DOUBLE_EQ(items.get<double>("ratio").get(), 0.5);
+  EXPECT_DOUBLE_EQ(items.get<double>("exp").get(), 1000.0);
+  EXPECT_TRUE(items.get<bool>("on").get());
+  EXPECT_FALSE(items.get<bool>("off").get());
+  EXPECT_EQ(items.get<std::int64_t>("big").get(), std::numeric_limits<std::int64_t>::max());
+  EXPECT_FALSE(items.get<std::int64_t>("over").is_initialized());
+  EXPECT_EQ(items.get<std::uint64_t>("over").get(), 9223372036854775808ull);
+  EXPECT_EQ(items.get<std::int64_t>("low").get(), std::numeric_limits<std::int64_t>::min());
+  EXPECT_EQ(items.get<std::int8_t>("limit").get(), 25);
+  EXPECT_FALSE(items.get<std::int8_t>("big").is_initialized());
+  EXPECT_EQ(items.get<int>("enc").get(), 42);
+  EXPECT_FALSE(items.get<int>("sp").is_initialized());
+  EXPECT_FALSE(items.get<int>("bad").is_initialized());
+  EXPECT_FALSE(items.get<double>("bad").is_initialized());
+  EXPECT_FALSE(items.get<int>("empty").is_initialized());
+  EXPECT_FALSE(items.get<bool>("flag").is_initialized());
+  EXPECT_FALSE(items.get<int>("missing").is_initialized());
+  EXPECT_EQ(items.get<int>("missing", 10), 10);
+  EXPECT_EQ(items.get<int>("limit", 10), 25);
+  EXPECT_TRUE(items.get<SortOrder>("sort").get() == SortOrder::Descending);
+
+  uri_parser::UriQueryView<char> numbers(boost::string_view("a=-0.05&b=.5&c=5.&d=1.7976931348623157e308&e=123456789012345678901234"
+                                                            "&f=1e400&g=e5&h=1e&i=--1&j=1e-2&k=0.1e%2B1"));
+  EXPECT_DOUBLE_EQ(numbers.get<double>("a").get(), -0.05);
+  EXPECT_DOUBLE_EQ(numbers.get<double>("b").get(), 0.5);
+  EXPECT_DOUBLE_EQ(numbers.get<double>("c").get(), 5.0);
+  EXPECT_EQ(numbers.get<double>("d").get(), std::numeric_limits<double>::max());
+  EXPECT_DOUBLE_EQ(numbers.get<double>("e").get(), 123456789012345678901234.0);
+  EXPECT_FALSE(numbers.get<double>("f").is_initialized());
+  EXPECT_FALSE(numbers.get<double>("g").is_initialized());
+  EXPECT_FALSE(numbers.get<double>("h").is_initialized());
+  EXPECT_FALSE(numbers.get<double>("i").is_initialized());
+  EXPECT_DOUBLE_EQ(numbers.get<double>("j").get(), 0.01);
+  EXPECT_DOUBLE_EQ(numbers.get<float>("k").get(), 1.0f);
+
+  // longer than any stack buffer: trailing zeros, zero padding, many digits
+  const std::string zeros(80, '0');
+  const std::string longText = "a=1." + zeros + "&b=" + zeros + "42.5&c=0." + zeros + "15e81"
+    + "&d=3.14159265358979323846264338327950288419716939937510582097494459230781640628620899862803482534";
+  uri_parser::UriQueryView<char> longNumbers{boost::string_view(longText)};
+  EXPECT_EQ(longNumbers.get<double>("a").get(), 1.0);
+  EXPECT_EQ(longNumbers.get<double>("b").get(), 42.5);
+  EXPECT_DOUBLE_EQ(longNumbers.get<double>("c").get(), 1.5);
+  EXPECT_EQ(longNumbers.get<double>("d").get(), 3.141592653589793);
+  EXPECT_EQ(longNumbers.get<float>("a").get(), 1.0f);
+
+  // just above 1 + 2^-24: through double it ties and rounds to 1, strtof rounds up
+  uri_parser::UriQueryView<char> floats(boost::string_view("a=1.00000005960464477550&b=0.1&c=16777217"));
+  EXPECT_EQ(floats.get<float>("a").get(), std::strtof("1.00000005960464477550", nullptr));
+  EXPECT_GT(floats.get<float>("a").get(), 1.0f);
+  EXPECT_EQ(floats.get<float>("b").get(), 0.1f);
+  EXPECT_EQ(floats.get<float>("c").get(), 16777216.0f);
+
+  // same conversions on the unescaped items
+  auto query = entry.Query();
+  EXPECT_EQ(query.get<int>("enc").get(), 42);
+  EXPECT_DOUBLE_EQ(query.get<double>("ratio").get(), 0.5);
+  EXPECT_TRUE(query.get<SortOrder>("sort").get() == SortOrder::Descending);
+  EXPECT_FALSE(query.get<int>("sp").is_initialized());
+
+  auto wideEntry = uri_parser::UriParseUrl(L"http://h.org/?n=%2D12&d=2.25");
+  EXPECT_EQ(wideEntry.QueryItems().get<long>(L"n").get(), -12);
+  EXPECT_DOUBLE_EQ(wideEntry.QueryItems().get<double>(L"d").get(), 2.25);
+}
+
+TEST(cppUriParser, extract_params)
+{
+  auto entry = uri_parser::UriParseUrl("http://h.org/?utm_source=news&x=1&utm_medium=mail&utm_%63ampaign=spring+sale"
+                                       "&utm_source=again&flag");
+  auto params = uri_parser::ExtractParams(entry, { "utm_source", "utm_medium", "utm_campaign", "gclid", "flag" });
+  ASSERT_EQ(params.size(), 5u);
+  EXPECT_EQ(params[0].value, "news");
+  EXPECT_EQ(params[1].value, "mail");
+  EXPECT_EQ(params[2].value, "spring+sale");
+  EXPECT_EQ(params[2].UnescapedValue(), "spring sale");
+  EXPECT_TRUE(params[3].key.data() == nullptr);
+  EXPECT_TRUE(params[4].key.data() != nullptr);
+  EXPECT_FALSE(params[4].hasValue());
+
+  // same answers as findKey for every key, also with a precompiled set of many keys
+  const char* const manyKeys[] = { "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p",
+                                   "ab", "ba", "abc", "acb", "", "zz" };
+  static const uri_parser::QueryParamSet<char, 22> keySet(manyKeys);
+  uri_parser::UriQueryView<char> query(boost::string_view("ab=1&acb=2&p=3&=4&zz&b=5&ba=6&abc=7&a%62=8&q=9&a=10"));
+  auto many = uri_parser::ExtractParams(query, keySet);
+  for (std::size_t idx = 0; idx < keySet.size(); ++idx)
+  {
+    EXPECT_EQ(keySet.find(keySet[idx]), idx);
+    auto expected = query.findKey(keySet[idx]);
+    if (expected == query.end())
+    {
+      EXPECT_TRUE(many[idx].key.data() == nullptr) << keySet[idx];
+    }
+    else
+    {
+      EXPECT_EQ(many[idx].key.data(), expected->key.data()) << keySet[idx];
+    }
+  }
+  EXPECT_EQ(keySet.find("x"), keySet.size());
+
+  // '+' in query keys decodes to a space
+  uri_parser::UriQueryView<char> plus(boost::string_view("a+b=1&a%2Bb=2&c+d=3"));
+  auto plusParams = uri_parser::ExtractParams(plus, { "a+b", "c d" });
+  EXPECT_EQ(plusParams[0].value, "2");
+  EXPECT_EQ(plusParams[1].value, "3");
+
+  auto wideEntry = uri_parser::UriParseUrl(L"http://h.org/?gclid=abc&utm_source=s");
+  auto wide = uri_parser::ExtractParams(wideEntry, { L"utm_source", L"gclid" });
+  EXPECT_EQ(wide[0].value, L"s");
+  EXPECT_EQ(wide[1].value, L"abc");
+}
+
+TEST(cppUriParser, canonicalize_query)
+{
+  typedef uri_parser::QueryCanonicalPolicy<char> Policy;
+  auto entry = uri_parser::UriParseUrl("http://h.org/?b=2&utm_source=x&a=1&c&b=1&utm_%6Dedium=y&a=0&gclid=z");
+  std::string out;
+
+  Policy tracking;
+  tracking.Deny("utm_source").Deny("utm_medium").Deny("gclid");
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry, tracking, out), "a=1&a=0&b=2&b=1&c");
+
+  Policy byValue(Policy::kSortByKeyAndValue);
+  byValue.Deny("utm_source").Deny("utm_medium").Deny("gclid");
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry, byValue, out), "a=0&a=1&b=1&b=2&c");
+
+  Policy first(Policy::kSortByKeyAndValue, Policy::kKeepFirst);
+  first.Allow("a").Allow("b");
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry, first, out), "a=1&b=2");
+
+  Policy last(Policy::kKeepOrder, Policy::kKeepLast);
+  last.Allow("b").Allow("a").Allow("c");
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry, last, out), "c&b=1&a=0");
+
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry, Policy(Policy::kKeepOrder), out), entry.QueryItems().text());
+  EXPECT_THROW(Policy().Allow("a").Deny("b"), std::runtime_error);
+
+  // caller buffer, never longer than the query
+  char buffer[8];
+  const std::size_t size = uri_parser::CanonicalizeQuery(entry, first, buffer, sizeof(buffer));
+  EXPECT_EQ(std::string(buffer, size), "a=1&b=2");
+  EXPECT_THROW(uri_parser::CanonicalizeQuery(entry, tracking, buffer, sizeof(buffer)), std::length_error);
+
+  // more pairs than fit on the stack
+  std::string longQuery = "http://h.org/?";
+  for (int idx = 99; idx >= 0; --idx)
+  {
+    longQuery += "k" + std::to_string(idx % 50) + "=" + std::to_string(idx) + "&";
+  }
+  auto longEntry = uri_parser::UriParseUrl(longQuery.c_str());
+  Policy dedupe(Policy::kSortByKey, Policy::kKeepLast);
+  uri_parser::CanonicalizeQuery(longEntry, dedupe, out);
+  EXPECT_EQ(out.substr(0, 16), "k0=0&k1=1&k10=10");
+  EXPECT_EQ(std::count(out.begin(), out.end(), '&'), 49);
+
+  auto wideEntry = uri_parser::UriParseUrl(L"http://h.org/?z=1&y=2");
+  std::wstring wide;
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(wideEntry, uri_parser::QueryCanonicalPolicy<wchar_t>(), wide), L"y=2&z=1");
+}
+
+TEST(cppUriParser, query_separators)
+{
+  auto entry = uri_parser::UriParseUrl("http://h.org/?a=1;b=x%20y;c;d=p,q&r");
+
+  auto semicolon = entry.QueryItems<uri_parser::SemicolonQuerySeparators>();
+  EXPECT_EQ(semicolon.size(), 4u);
+  EXPECT_EQ(semicolon.GetValue("b").get(), "x y");
+  EXPECT_EQ(semicolon.GetValue("d").get(), "p,q&r");
+  EXPECT_FALSE(semicolon.findKey("c")->hasValue());
+
+  const auto& query = entry.Query<uri_parser::SemicolonQuerySeparators>();
+  ASSERT_EQ(query.size(), 4u);
+  EXPECT_EQ(query[1].key, "b");
+  EXPECT_EQ(query[1].value, "x y");
+  EXPECT_EQ(query[2].value, "");
+  EXPECT_EQ(query.findKey("d")->value, "p,q&r");
+
+  // switching separators dissects again
+  EXPECT_EQ(entry.Query().size(), 2u);
+  EXPECT_EQ(entry.Query().findKey("a")->value, "1;b=x y;c;d=p,q");
+  typedef uri_parser::QuerySeparators<',', ';'> CommaSemicolon;
+  EXPECT_EQ(entry.Query<CommaSemicolon>().size(), 2u);
+  EXPECT_EQ(entry.Query<CommaSemicolon>()[1].key, "q&r");
+  EXPECT_EQ(entry.Query<CommaSemicolon>()[0].value, "b=x y;c;d=p");
+
+  // same items as the C dissect gives for the '&' version of the query
+  auto ampersand = uri_parser::UriParseUrl("http://h.org/?a=1&b=x+y%21&=e&&k&k2=&%3D=%26");
+  auto semicolonUrl = uri_parser::UriParseUrl("http://h.org/?a=1;b=x+y%21;=e;;k;k2=;%3D=%26");
+  const auto& expected = ampersand.Query();
+  const auto& actual = semicolonUrl.Query<uri_parser::SemicolonQuerySeparators>();
+  ASSERT_EQ(actual.size(), expected.size());
+  for (std::size_t idx = 0; idx < expected.size(); ++idx)
+  {
+    EXPECT_EQ(actual[idx].key, expected[idx].key);
+    EXPECT_EQ(actual[idx].value, expected[idx].value);
+  }
+
+  // the builder escapes the separators inside keys & values
+  uri_parser::BasicQueryBuilder<char, uri_parser::internal::QueryBuilderHeapStorage<char>, uri_parser::SemicolonQuerySeparators> builder;
+  builder.Append("a", "x;y").Append("b", "1&2").Append("c");
+  EXPECT_EQ(builder.view(), "a=x%3By;b=1%262;c");
+  uri_parser::FixedQueryBuilder<32, char, uri_parser::PipeQuerySeparators> pipe;
+  pipe.Append("k", "a|b").Append("l", "2");
+  EXPECT_EQ(pipe.view(), "k=a%7Cb|l=2");
+  uri_parser::UriQueryView<char, uri_parser::PipeQuerySeparators> pipeView(pipe.view());
+  EXPECT_EQ(pipeView.GetValue("k").get(), "a|b");
+
+  uri_parser::QueryCanonicalPolicy<char> sorted;
+  std::string canonical;
+  EXPECT_EQ(uri_parser::CanonicalizeQuery(entry.QueryItems<uri_parser::SemicolonQuerySeparators>(), sorted, canonical), "a=1;b=x%20y;c;d=p,q&r");
+  auto params = uri_parser::ExtractParams(semicolon, { "d", "a" });
+  EXPECT_EQ(params[0].value, "p,q&r");
+  EXPECT_EQ(params[1].value, "1");
+}
+
+TEST(cppUriParser, query_view_splitting)
+{
+  // wchar_t views split with the portable scanner, char views with the block
+  // scanner when the query is long enough; both have to cut the same pairs
+  auto split = [](const std::string& query)
+  {
+    std::vector<std::string> items;
+    for (const auto& item: uri_parser::UriQueryView<char>(query))
+    {
+      items.push_back(item.key.to_string() + (item.hasValue() ? "=" + item.value.to_string() : "|"));
+    }
+    return items;
+  };
+  auto wideSplit = [](const std::string& query)
+  {
+    const std::wstring wide(query.begin(), query.end());
+    std::vector<std::string> items;
+    for (const auto& item: uri_parser::UriQueryView<wchar_t>(wide))
+    {
+      std::string key(item.key.begin(), item.key.end());
+      std::string value(item.value.begin(), item.value.end());
+      items.push_back(key + (item.hasValue() ? "=" + value : "|"));
+    }
+    return items;
+  };
+
+  EXPECT_EQ(split("a=b=c&&=&k&"), (std::vector<std::string>{ "a=b=c", "=", "k|" }));
+  std::string edges(63, 'x');
+  edges += "&y=1";
+  EXPECT_EQ(split(edges), (std::vector<std::string>{ std::string(63, 'x') + "|", "y=1" }));
+  edges = std::string(64, 'x') + "=&" + std::string(62, 'z') + "&";
+  EXPECT_EQ(split(edges), (std::vector<std::string>{ std::string(64, 'x') + "=", std::string(62, 'z') + "|" }));
+
+  std::mt19937 random(19);
+  const char alphabet[] = "ab=&&==&k%";
+  for (int round = 0; round < 3000; ++round)
+  {
+    std::string query(random() % 300, 'a');
+    for (auto& ch: query)
+    {
+      ch = alphabet[random() % (sizeof(alphabet) - 1)];
+    }
+    ASSERT_EQ(split(query), wideSplit(query)) << query;
+  }
+}
+
+TEST(cppUriParser, shared_query_across_threads)
+{
+  std::string url = "http://h.org/?";
+  for (int idx = 0; idx < 40; ++idx)
+  {
+    url += "k" + std::to_string(idx) + "=" + std::to_string(idx * 3) + "&";
+  }
+  auto entry = uri_parser::UriParseUrl(url.c_str());
+
+  // every thread races for the first Query() call, all of them get the same query
+  std::atomic<bool> start(false);
+  std::vector<const void*> seen(8);
+  std::vector<int> values(8);
+  std::vector<std::thread> readers;
+  for (std::size_t reader = 0; reader < seen.size(); ++reader)
+  {
+    readers.emplace_back([&, reader]
+    {
+      while (!start.load())
+      {
+        std::this_thread::yield();
+      }
+      const auto& query = entry.Query();
+      seen[reader] = &query;
+      values[reader] = query.get<int>("k" + std::to_string(30 + reader)).get_value_or(-1)
+        + entry.Query<uri_parser::SemicolonQuerySeparators>().get<int>("k0", 100);
+    });
+  }
+  start = true;
+  for (auto& reader: readers)
+  {
+    reader.join();
+  }
+  for (std::size_t reader = 0; reader < seen.size(); ++reader)
+  {
+    EXPECT_EQ(seen[reader], seen[0]);
+    EXPECT_EQ(values[reader], static_cast<int>(3 * (30 + reader) + 100));
+  }
+
+  // other separators do not invalidate a query handed out before
+  const auto& ampersand = entry.Query();
+  EXPECT_EQ(entry.Query<uri_parser::SemicolonQuerySeparators>().size(), 1u);
+  EXPECT_EQ(ampersand.size(), 40u);
+  EXPECT_EQ(&entry.Query(), &ampersand);
+
+  // published queries move along with the entry
+  auto moved = std::move(entry);
+  EXPECT_EQ(moved.Query().findKey("k39")->value, "117");
+  EXPECT_EQ(moved.Query<uri_parser::SemicolonQuerySeparators>().size(), 1u);
+  EXPECT_EQ(moved.Query().size(), 40u);
+}
+
+TEST(cppUriParser, shared_path_segments_across_threads)
+{
+  for (int round = 0; round < 200; ++round)
+  {
+    auto entry = uri_parser::UriParseUrl("http://h.org/a/bb/ccc/dddd/eeeee/ffffff");
+
+    // both threads race for the first PathSegments() call, each sees the whole path
+    std::atomic<bool> start(false);
+    std::vector<std::size_t> sizes(2);
+    std::vector<std::string> lasts(2);
+    std::vector<std::thread> readers;
+    for (std::size_t reader = 0; reader < sizes.size(); ++reader)
+    {
+      readers.emplace_back([&, reader]
+      {
+        while (!start.load())
+        {
+          std::this_thread::yield();
+        }
+        const auto segments = entry.PathSegments();
+        sizes[reader] = segments.size();
+        lasts[reader] = std::string(segments[segments.size() - 1].data(), segments[segments.size() - 1].size());
+      });
+    }
+    start = true;
+    for (auto& reader: readers)
+    {
+      reader.join();
+    }
+    for (std::size_t reader = 0; reader < sizes.size(); ++reader)
+    {
+      ASSERT_EQ(sizes[reader], 6u) << round;
+      ASSERT_EQ(lasts[reader], "ffffff") << round;
+    }
+  }
+}
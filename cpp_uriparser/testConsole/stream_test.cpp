@@ -0,0 +1,150 @@
+#include "cpp_uriparser_stream.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // text cut into random chunks, empty ones included
+  template <class CharType>
+  std::vector<boost::basic_string_view<CharType>> RandomChunks(const std::basic_string<CharType>& text, std::mt19937& random)
+  {
+    std::vector<boost::basic_string_view<CharType>> chunks;
+    for (std::size_t pos = 0; pos < text.size();)
+    {
+      const std::size_t size = std::min<std::size_t>(random() % 6, text.size() - pos);
+      chunks.emplace_back(text.data() + pos, size);
+      pos += size;
+    }
+    return chunks;
+  }
+
+  std::string RandomEscapedText(std::mt19937& random)
+  {
+    static const char* const pieces[] = { "%", "%4", "%41", "%0D", "%0a", "%0D%0A", "%e2%82%ac", "%zz", "+", "\r", "\n", "%00" };
+    std::string text;
+    for (unsigned int length = random() % 60; text.size() < length;)
+    {
+      if (random() % 3 == 0)
+      {
+        text += pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))];
+      }
+      else
+      {
+        text += static_cast<char>('!' + random() % 94);
+      }
+    }
+    return text;
+  }
+
+  std::string EscapeAcrossNul(const std::string& text, bool spaceToPlus, bool normalizeBreaks)
+  {
+    std::string escaped;
+    for (std::size_t pos = 0;;)
+    {
+      const std::size_t nul = std::min(text.find('\0', pos), text.size());
+      escaped += uri_parser::Escape(boost::string_view(text).substr(pos, nul - pos), spaceToPlus, normalizeBreaks);
+      if (nul == text.size())
+      {
+        return escaped;
+      }
+      escaped += "%00";
+      pos = nul + 1;
+    }
+  }
+}
+
+TEST(streaming, unescaper_carries_groups_and_breaks)
+{
+  uri_parser::StreamingUnescaper unescaper(true, URI_BR_TO_LF);
+  std::string out;
+  for (auto chunk : { "a%", "4", "1%0", "D", "%0A+%", "" })
+  {
+    unescaper.Feed(chunk, out);
+  }
+  EXPECT_EQ(out, "aA\n ");
+  unescaper.Finish(out);
+  EXPECT_EQ(out, "aA\n %");
+
+  // random cuts, every flag combination, both character types
+  static const UriBreakConversion conversions[] = { URI_BR_TO_LF, URI_BR_TO_CRLF, URI_BR_TO_CR, URI_BR_DONT_TOUCH };
+  std::mt19937 random(25);
+  for (int round = 0; round < 5000; ++round)
+  {
+    const std::string text = RandomEscapedText(random);
+    const bool plusToSpace = (round & 1) != 0;
+    const UriBreakConversion breakConversion = conversions[(round >> 1) & 3];
+
+    uri_parser::StreamingUnescaper unescaper(plusToSpace, breakConversion);
+    std::string streamed;
+    for (auto chunk : RandomChunks(text, random))
+    {
+      std::vector<char> out(uri_parser::StreamingUnescaper::WorstCaseSize(chunk.size()), 'X');
+      streamed.append(out.data(), unescaper.Feed(chunk, out.data()));
+    }
+    unescaper.Finish(streamed);
+    ASSERT_EQ(streamed, uri_parser::Unescape(text, plusToSpace, breakConversion)) << round << ' ' << text;
+
+    const std::wstring wide(text.begin(), text.end());
+    uri_parser::WStreamingUnescaper wideUnescaper(plusToSpace, breakConversion);
+    std::wstring wideStreamed;
+    for (auto chunk : RandomChunks(wide, random))
+    {
+      wideUnescaper.Feed(chunk, wideStreamed);
+    }
+    wideUnescaper.Finish(wideStreamed);
+    ASSERT_EQ(wideStreamed, uri_parser::Unescape(wide, plusToSpace, breakConversion)) << round;
+  }
+}
+
+TEST(streaming, escaper_matches_whole_text)
+{
+  uri_parser::StreamingEscaper escaper(true, true);
+  std::string out;
+  for (auto chunk : { "a b\r", "\nc\r", "", "\n", "\n" })
+  {
+    escaper.Feed(chunk, out);
+  }
+  EXPECT_EQ(out, "a+b%0D%0Ac%0D%0A%0D%0A");
+  escaper.Feed(boost::string_view("\0/", 2), out);
+  EXPECT_EQ(out, "a+b%0D%0Ac%0D%0A%0D%0A%00%2F");
+
+  std::mt19937 random(25);
+  const std::string alphabet = std::string("ab ~/\r\n\r\n%+\xff", 13) + '\0';
+  for (int round = 0; round < 5000; ++round)
+  {
+    std::string text(random() % 60, 'a');
+    for (auto& ch : text)
+    {
+      ch = alphabet[random() % alphabet.size()];
+    }
+    const bool spaceToPlus = (round & 1) != 0;
+    const bool normalizeBreaks = (round & 2) != 0;
+
+    uri_parser::StreamingEscaper escaper(spaceToPlus, normalizeBreaks);
+    std::string streamed;
+    for (auto chunk : RandomChunks(text, random))
+    {
+      std::vector<char> out(escaper.WorstCaseSize(chunk.size()), 'X');
+      const std::size_t written = escaper.Feed(chunk, out.data());
+      ASSERT_EQ(out[written], '\0');
+      streamed.append(out.data(), written);
+    }
+    escaper.Finish();
+    ASSERT_EQ(streamed, EscapeAcrossNul(text, spaceToPlus, normalizeBreaks)) << round;
+
+    if (!normalizeBreaks)
+    {
+      // and back again, cut differently
+      uri_parser::StreamingUnescaper unescaper(spaceToPlus);
+      std::string decoded;
+      for (auto chunk : RandomChunks(streamed, random))
+      {
+        unescaper.Feed(chunk, decoded);
+      }
+      unescaper.Finish(decoded);
+      ASSERT_EQ(decoded, text) << round;
+    }
+  }
+}
@@ -1,5 +1,6 @@
 #include "cpp_uriparser.h"
 #include <iostream>
+#include <random>
 #include <gtest/gtest.h>
 
 using namespace uri_parser;
@@ -71,15 +72,441 @@ TEST(uriparserFreeFunctions, unescape_function_normal)
   EXPECT_STREQ("\r\n\b\t", unescapedString2.c_str());
 }
 
-TEST(cppUriParser, DISABLED_UriTypesMoveTest)
+namespace
 {
-  typedef uri_parser::internal::UriTypes<wchar_t*> UriTypesChar;
-  UriTypesChar uriTypes;
-  /*
-  EXPECT_TRUE(uriTypes.freeUriMembers);
+  // uriEscapeEx as it was before the class table, one character per step
+  template <class CharType>
+  std::basic_string<CharType> ReferenceEscape(const std::basic_string<CharType>& text, bool spaceToPlus, bool normalizeBreaks)
+  {
+    static const char hex[] = "0123456789ABCDEF";
+    std::basic_string<CharType> out;
+    bool prevWasCr = false;
+    for (std::size_t idx = 0; idx < text.size(); ++idx)
+    {
+      const CharType ch = text[idx];
+      if (ch == 0)
+      {
+        break;
+      }
+      if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+        || ch == '-' || ch == '.' || ch == '_' || ch == '~')
+      {
+        out += ch;
+      }
+      else if (ch == ' ')
+      {
+        out += spaceToPlus ? std::basic_string<CharType>(1, '+') : std::basic_string<CharType>{ '%', '2', '0' };
+      }
+      else if (ch == '\n')
+      {
+        if (!normalizeBreaks)
+        {
+          out += std::basic_string<CharType>{ '%', '0', 'A' };
+        }
+        else if (!prevWasCr)
+        {
+          out += std::basic_string<CharType>{ '%', '0', 'D', '%', '0', 'A' };
+        }
+      }
+      else if (ch == '\r')
+      {
+        out += normalizeBreaks ? std::basic_string<CharType>{ '%', '0', 'D', '%', '0', 'A' } : std::basic_string<CharType>{ '%', '0', 'D' };
+      }
+      else
+      {
+        const unsigned char code = static_cast<unsigned char>(ch);
+        out += std::basic_string<CharType>{ '%', static_cast<CharType>(hex[code >> 4]), static_cast<CharType>(hex[code & 0x0f]) };
+      }
+      prevWasCr = ch == '\r';
+    }
+    return out;
+  }
+
+  template <class CharType>
+  std::basic_string<CharType> LibraryEscape(const std::basic_string<CharType>& text, bool bounded, bool spaceToPlus, bool normalizeBreaks)
+  {
+    typedef uri_parser::internal::UriTypes<const CharType*> UriApiTypes;
+    std::vector<CharType> out(text.size() * 6 + 1, 'X');
+    CharType* end = bounded
+      ? UriApiTypes::uriEscapeEx(text.data(), text.data() + text.size(), out.data(), spaceToPlus, normalizeBreaks)
+      : UriApiTypes::uriEscapeEx(text.c_str(), nullptr, out.data(), spaceToPlus, normalizeBreaks);
+    EXPECT_EQ(*end, 0);
+    return std::basic_string<CharType>(out.data(), end);
+  }
+
+  template <class CharType>
+  std::basic_string<CharType> LibraryUnescape(std::basic_string<CharType> text, bool plusToSpace, UriBreakConversion breakConversion)
+  {
+    typedef uri_parser::internal::UriTypes<const CharType*> UriApiTypes;
+    auto end = UriApiTypes::uriUnescapeInPlaceEx(&text[0], plusToSpace ? URI_TRUE : URI_FALSE, breakConversion);
+    return std::basic_string<CharType>(text.c_str(), end);
+  }
+}
+
+TEST(uriparserFreeFunctions, escape_matches_reference)
+{
+  EXPECT_EQ(LibraryEscape<char>("a b\r\n-._~/?\xff", true, true, true), "a+b%0D%0A-._~%2F%3F%FF");
+  EXPECT_EQ(LibraryEscape<char>(std::string(40, 'z') + "&" + std::string(20, 'Z'), false, false, false),
+    std::string(40, 'z') + "%26" + std::string(20, 'Z'));
+  EXPECT_EQ(LibraryEscape<wchar_t>(L"\x120 \r", true, false, false), L"%20%20%0D");
+
+  // long unreserved runs with rare other characters, so block copies and
+  // their tails are both hit; all bytes, NUL included, both flags, both ends
+  std::mt19937 random(21);
+  const std::string unreserved = "abcXYZ0189-._~";
+  for (int round = 0; round < 20000; ++round)
+  {
+    std::string text(random() % 80, 'a');
+    const unsigned int density = 1 + random() % 40;
+    for (auto& ch: text)
+    {
+      ch = (random() % density == 0) ? static_cast<char>(random() % 256) : unreserved[random() % unreserved.size()];
+    }
+    const bool bounded = (round & 1) != 0;
+    const bool spaceToPlus = (round & 2) != 0;
+    const bool normalizeBreaks = (round & 4) != 0;
+    ASSERT_EQ(LibraryEscape(text, bounded, spaceToPlus, normalizeBreaks), ReferenceEscape(text, spaceToPlus, normalizeBreaks)) << round;
+
+    const std::wstring wide(text.begin(), text.end());
+    ASSERT_EQ(LibraryEscape(wide, bounded, spaceToPlus, normalizeBreaks), ReferenceEscape(wide, spaceToPlus, normalizeBreaks)) << round;
+  }
+}
+
+TEST(uriparserFreeFunctions, escaped_length_is_exact)
+{
+  EXPECT_EQ(uri_parser::EscapedLength("a b\r\n/"), 14u);
+  EXPECT_EQ(uri_parser::EscapedLength("a b\r\n/", true, true), 12u);
+  EXPECT_EQ(uri_parser::Escape(std::string("a b\0c", 5)), "a%20b");
+  EXPECT_EQ(uri_parser::Escape(L"\r\n x", true, true), L"%0D%0A+x");
+  EXPECT_EQ(uri_parser::Escape(""), "");
 
-  std::unique_ptr<UriTypesChar> uriTypesEmpty = std::make_unique<UriTypesChar>(std::move(uriTypes));
-  EXPECT_TRUE(uriTypesEmpty->freeUriMembers);
-  EXPECT_TRUE(uriTypes.freeUriMembers);
-  */
-}
\ No newline at end of file
+  // mostly unreserved text so whole blocks are counted at once, with spaces,
+  // breaks, NUL and high bytes landing on block edges now and then
+  std::mt19937 random(23);
+  const std::string unreserved = "azAZ09-._~";
+  const std::string special = std::string(" \r\n/%+\x80\xff", 8) + '\0';
+  for (int round = 0; round < 20000; ++round)
+  {
+    std::string text(random() % 100, 'a');
+    const unsigned int density = 1 + random() % 50;
+    for (auto& ch: text)
+    {
+      ch = (random() % density == 0) ? special[random() % special.size()] : unreserved[random() % unreserved.size()];
+    }
+    const bool spaceToPlus = (round & 1) != 0;
+    const bool normalizeBreaks = (round & 2) != 0;
+
+    const std::string expected = LibraryEscape(text, true, spaceToPlus, normalizeBreaks);
+    ASSERT_EQ(uri_parser::EscapedLength(text, spaceToPlus, normalizeBreaks), expected.size()) << round;
+    ASSERT_EQ(uri_parser::Escape(text, spaceToPlus, normalizeBreaks), expected) << round;
+
+    const std::wstring wide(text.begin(), text.end());
+    ASSERT_EQ(uri_parser::EscapedLength(wide, spaceToPlus, normalizeBreaks), LibraryEscape(wide, true, spaceToPlus, normalizeBreaks).size()) << round;
+  }
+}
+
+TEST(uriparserFreeFunctions, escape_profiles)
+{
+  const std::string text = "a b/c:d@e?f=g&h+i#j;k%l!m";
+  EXPECT_EQ(uri_parser::Escape<uri_parser::UnreservedEscapeProfile>(text), uri_parser::Escape(text));
+  EXPECT_EQ(uri_parser::Escape<uri_parser::PathSegmentEscapeProfile>(text), "a%20b%2Fc:d@e%3Ff=g&h+i%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::PathEscapeProfile>(text), "a%20b/c:d@e%3Ff=g&h+i%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::QueryKeyEscapeProfile<>>(text), "a%20b/c:d@e?f%3Dg%26h%2Bi%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::QueryValueEscapeProfile<>>(text), "a%20b/c:d@e?f=g%26h%2Bi%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::QueryValueEscapeProfile<uri_parser::SemicolonQuerySeparators>>(text),
+    "a%20b/c:d@e?f=g&h%2Bi%23j%3Bk%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::FragmentEscapeProfile>(text), "a%20b/c:d@e?f=g&h+i%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::UserInfoEscapeProfile>(text), "a%20b%2Fc:d%40e%3Ff=g&h+i%23j;k%25l!m");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::PathEscapeProfile>(std::string("\0\xff/", 3)), "%00%FF/");
+  EXPECT_EQ(uri_parser::Escape<uri_parser::FragmentEscapeProfile>(L"\x120/#"), L"%20/%23");
+  EXPECT_EQ(uri_parser::EscapedLength<uri_parser::PathEscapeProfile>("/a b"), 6u);
+  char buffer[12];
+  EXPECT_EQ(uri_parser::EscapeInto<uri_parser::PathSegmentEscapeProfile>("/a b", buffer), 8u);
+  EXPECT_EQ(std::string(buffer, 8), "%2Fa%20b");
+
+  // every component escaped with its profile parses back to the same text
+  std::mt19937 random(24);
+  auto randomText = [&random]() {
+    std::string part(1 + random() % 20, 'a');
+    for (auto& ch: part)
+    {
+      ch = static_cast<char>(random() % 3 == 0 ? random() % 256 : ' ' + random() % 95);
+    }
+    return part;
+  };
+  for (int round = 0; round < 2000; ++round)
+  {
+    const std::string user = randomText(), path = randomText(), key = randomText(), value = randomText(), fragment = randomText();
+    const std::string escapedUser = uri_parser::Escape<uri_parser::UserInfoEscapeProfile>(user);
+    const std::string escapedPath = '/' + uri_parser::Escape<uri_parser::PathEscapeProfile>(path);
+    const std::string escapedFragment = uri_parser::Escape<uri_parser::FragmentEscapeProfile>(fragment);
+    auto entry = uri_parser::UriParseUrl("http://" + escapedUser + "@h.org" + escapedPath
+      + '?' + uri_parser::Escape<uri_parser::QueryKeyEscapeProfile<>>(key) + '=' + uri_parser::Escape<uri_parser::QueryValueEscapeProfile<>>(value)
+      + '#' + escapedFragment);
+
+    ASSERT_EQ(entry.UserInfoView(), escapedUser) << round;
+    ASSERT_EQ(entry.PathView(), escapedPath) << round;
+    ASSERT_EQ(entry.FragmentView(), escapedFragment) << round;
+    ASSERT_EQ(uri_parser::Unescape(entry.UserInfoView(), false), user) << round;
+    ASSERT_EQ(uri_parser::Unescape(entry.PathView().substr(1), false), path) << round;
+    ASSERT_EQ(uri_parser::Unescape(entry.FragmentView(), false), fragment) << round;
+    ASSERT_EQ(uri_parser::UriQueryView<char>(entry.QueryView()).GetValue(key).get(), value) << round;
+  }
+}
+
+TEST(uriparserFreeFunctions, unescape_matches_library)
+{
+  EXPECT_EQ(uri_parser::Unescape("a+b%41%4g%%0D%0A%00z"), std::string("a bA%4g%\r\n\0z", 12));
+  EXPECT_EQ(uri_parser::Unescape(L"%0D%0A%0A%0D", false, URI_BR_TO_LF), L"\n\n\n");
+  EXPECT_EQ(uri_parser::UnescapeString(std::string("a%00b")), "a");
+
+  // sparse escapes over long plain runs, broken groups and line breaks;
+  // decoded into a separate buffer and in place, every flag combination
+  static const UriBreakConversion conversions[] = { URI_BR_TO_LF, URI_BR_TO_CRLF, URI_BR_TO_CR, URI_BR_DONT_TOUCH };
+  static const char* const pieces[] = { "%", "%4", "%41", "%0D", "%0a", "%0d%0A", "%e2%82%ac", "%zz", "+", "\r", "\n" };
+  std::mt19937 random(22);
+  for (int round = 0; round < 20000; ++round)
+  {
+    std::string text;
+    const unsigned int density = 1 + random() % 30;
+    for (unsigned int length = random() % 90; text.size() < length;)
+    {
+      if (random() % density == 0)
+      {
+        text += pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))];
+      }
+      else
+      {
+        text += static_cast<char>('!' + random() % 94);
+      }
+    }
+    const bool plusToSpace = (round & 1) != 0;
+    const UriBreakConversion breakConversion = conversions[(round >> 1) & 3];
+
+    const std::string expected = LibraryUnescape(text, plusToSpace, breakConversion);
+    std::string out(text.size(), 'X');
+    out.resize(uri_parser::Unescape(text, &out[0], plusToSpace, breakConversion));
+    ASSERT_EQ(out, expected) << round << ' ' << text;
+
+    std::string inPlace = text;
+    inPlace.resize(uri_parser::Unescape(inPlace, &inPlace[0], plusToSpace, breakConversion));
+    ASSERT_EQ(inPlace, expected) << round;
+
+    const std::wstring wide(text.begin(), text.end());
+    ASSERT_EQ(uri_parser::Unescape(wide, plusToSpace, breakConversion), LibraryUnescape(wide, plusToSpace, breakConversion)) << round;
+  }
+}
+
+TEST(cppUriParser, parsing_with_arena)
+{
+  uri_parser::UriParseArena<> arena;
+  {
+    auto entry = uri_parser::UriParseUrl("http://127.0.0.1/first/second/third", arena);
+    auto pathHead = entry.PathHead();
+
+    auto id = 0;
+    for (auto pathFragment = std::begin(pathHead); pathFragment != std::end(pathHead); ++pathFragment, ++id)
+    {
+      switch (id)
+      {
+      case 0:
+        EXPECT_STREQ(pathFragment->c_str(), "first");
+        break;
+      case 1:
+        EXPECT_STREQ(pathFragment->c_str(), "second");
+        break;
+      case 2:
+        EXPECT_STREQ(pathFragment->c_str(), "third");
+        break;
+      default:
+        ADD_FAILURE();
+        break;
+      }
+    }
+    EXPECT_EQ(id, 3);
+    EXPECT_STREQ(entry.HostText().get().c_str(), "127.0.0.1");
+    EXPECT_GT(arena.used, 0u);
+  }
+  arena.Reset();
+  EXPECT_EQ(arena.used, 0u);
+
+  // segments which do not fit into the arena are taken from the heap
+  uri_parser::UriParseArena<16> tinyArena;
+  auto entry = uri_parser::UriParseUrl("http://www.example.com/a/b/c/d/e", tinyArena);
+  EXPECT_STREQ(entry.HostText().get().c_str(), "www.example.com");
+  EXPECT_LE(tinyArena.used, 16u);
+}
+
+TEST(uriparserFreeFunctions, parse_arena_reclaims_rejected_ip4)
+{
+  uri_parser::UriParseArena<> arena;
+  const char* url = "http://www.example.com/";
+
+  UriUriA uri;
+  UriParserStateA state;
+  state.uri = &uri;
+  ASSERT_EQ(uriParseUriExArenaA(&state, url, url + strlen(url), &arena), URI_SUCCESS);
+  EXPECT_TRUE(uri.hostData.ip4 == nullptr);
+  EXPECT_EQ(arena.used, sizeof(UriPathSegmentA));
+  uriFreeUriMembersA(&uri);
+
+  EXPECT_EQ(uriParseUriExArenaA(&state, url, url + strlen(url), nullptr), URI_ERROR_NULL);
+}
+
+TEST(cppUriParser, uri_types_are_stateless)
+{
+  // the C api is reached through static forwarders, nothing is stored per entry
+  static_assert(std::is_empty<uri_parser::internal::UriTypes<const char*>>::value, "UriTypes must stay stateless");
+  static_assert(std::is_empty<uri_parser::internal::UriTypes<wchar_t*>>::value, "UriTypes must stay stateless");
+  static_assert(std::is_trivially_copyable<uri_parser::internal::UriTypes<wchar_t*>>::value, "UriTypes must stay trivially movable");
+}
+
+TEST(cppUriParser, reusable_parser)
+{
+  uri_parser::Parser<const char*> parser;
+
+  const auto& first = parser.parse("http://www.example.com/a/b?x=1");
+  EXPECT_STREQ(first.HostText().get().c_str(), "www.example.com");
+  EXPECT_STREQ(first.Query().findKey("x")->value.c_str(), "1");
+
+  const char* url = "https://other.org/only/path/segments/here";
+  const auto& second = parser.parse(url, url + strlen(url));
+  EXPECT_STREQ(second.Scheme().get().c_str(), "https");
+  EXPECT_STREQ(second.HostText().get().c_str(), "other.org");
+  EXPECT_TRUE(second.Query().empty());
+
+  auto pathHead = second.PathHead();
+  EXPECT_EQ(std::distance(std::begin(pathHead), std::end(pathHead)), 4);
+
+  EXPECT_THROW(parser.parse("http://[broken/"), std::runtime_error);
+  EXPECT_STREQ(parser.parse("ftp://files.org/").HostText().get().c_str(), "files.org");
+}
+
+TEST(cppUriParser, view_accessors)
+{
+  const char* url = "https://user:pw@www.example.com:8080/a/b//c/?x=1&y=2#frag";
+  auto entry = uri_parser::UriParseUrl(url);
+
+  EXPECT_EQ(entry.SchemeView(), "https");
+  EXPECT_EQ(entry.UserInfoView(), "user:pw");
+  EXPECT_EQ(entry.HostView(), "www.example.com");
+  EXPECT_EQ(entry.PortView(), "8080");
+  EXPECT_EQ(entry.PathView(), "/a/b//c/");
+  EXPECT_EQ(entry.QueryView(), "x=1&y=2");
+  EXPECT_EQ(entry.FragmentView(), "frag");
+
+  // views point into the source text
+  EXPECT_EQ(entry.SchemeView().data(), url);
+
+  auto bare = uri_parser::UriParseUrl("http://www.example.com");
+  EXPECT_TRUE(bare.PathView().data() == nullptr);
+  EXPECT_TRUE(bare.PortView().data() == nullptr);
+  EXPECT_TRUE(bare.QueryView().data() == nullptr);
+
+  auto emptyQuery = uri_parser::UriParseUrl("http://www.example.com/?#");
+  EXPECT_EQ(emptyQuery.PathView(), "/");
+  EXPECT_TRUE(emptyQuery.QueryView().empty() && emptyQuery.QueryView().data() != nullptr);
+  EXPECT_TRUE(emptyQuery.FragmentView().empty() && emptyQuery.FragmentView().data() != nullptr);
+
+  EXPECT_EQ(uri_parser::UriParseUrl("mailto:someone@example.com").PathView(), "someone@example.com");
+  EXPECT_EQ(uri_parser::UriParseUrl("/rel/path?q").PathView(), "/rel/path");
+  EXPECT_EQ(uri_parser::UriParseUrl(L"file:///etc/hosts").PathView(), L"/etc/hosts");
+}
+
+TEST(cppUriParser, owning_entry)
+{
+  // short text is copied inline, survives both the source string and the move out of UriParseUrl
+  auto shortEntry = uri_parser::UriParseUrl(std::string("http://www.example.com/a/b?x=1"));
+  EXPECT_EQ(shortEntry.HostView(), "www.example.com");
+  EXPECT_EQ(shortEntry.PathView(), "/a/b");
+  EXPECT_STREQ(shortEntry.Query().findKey("x")->value.c_str(), "1");
+
+  std::string longUrl = "http://www.example.com/" + std::string(200, 'p') + "?q=2";
+  auto longEntry = uri_parser::UriParseUrl(std::move(longUrl));
+  EXPECT_EQ(longEntry.PathView().size(), 201u);
+  EXPECT_EQ(longEntry.QueryView(), "q=2");
+
+  auto wideEntry = uri_parser::UriParseUrl(std::wstring(L"https://example.org/w"));
+  EXPECT_EQ(wideEntry.PathView(), L"/w");
+
+  // non NUL-terminated slices
+  const char frame[] = "GET http://www.example.com/index.html HTTP/1.1";
+  uri_parser::UriEntry<const char*> borrowed(frame + 4, frame + 37);
+  EXPECT_EQ(borrowed.PathView(), "/index.html");
+  EXPECT_STREQ(borrowed.GetUnescapedUrlString().c_str(), "http://www.example.com/index.html");
+
+  std::string buffer = "http://copied.org/path";
+  uri_parser::UriEntry<const char*> copied(boost::string_view(buffer), true);
+  buffer.assign(buffer.size(), '#');
+  EXPECT_EQ(copied.HostView(), "copied.org");
+  EXPECT_EQ(copied.PathView(), "/path");
+}
+
+TEST(cppUriParser, flat_path_segments)
+{
+  auto entry = uri_parser::UriParseUrl("http://www.example.com/api/v2//users/42?x=1");
+  auto segments = entry.PathSegments();
+  ASSERT_EQ(segments.size(), 5u);
+  EXPECT_EQ(segments[0], "api");
+  EXPECT_EQ(segments[2], "");
+  EXPECT_EQ(segments.back(), "42");
+  EXPECT_EQ(segments.end() - segments.begin(), 5);
+
+  std::vector<std::string> reversed;
+  for (auto segment = segments.rbegin(); segment != segments.rend(); ++segment)
+  {
+    reversed.push_back(segment->to_string());
+  }
+  EXPECT_EQ(reversed, (std::vector<std::string>{"42", "users", "", "v2", "api"}));
+
+  EXPECT_TRUE(uri_parser::UriParseUrl("http://www.example.com").PathSegments().empty());
+
+  // offsets follow the text when inline owned text moves
+  auto owned = uri_parser::UriParseUrl(std::string("http://h.org/a/bc"));
+  EXPECT_EQ(owned.PathSegments()[1], "bc");
+  auto movedOwned = std::move(owned);
+  EXPECT_EQ(movedOwned.PathSegments()[1], "bc");
+
+  // normalized entries own their segments
+  auto normalized = uri_parser::UriParseUrl("http://h.org/a/./b/../%7ec");
+  normalized.Normalize();
+  auto normalizedSegments = normalized.PathSegments();
+  ASSERT_EQ(normalizedSegments.size(), 2u);
+  EXPECT_EQ(normalizedSegments[0], "a");
+  EXPECT_EQ(normalizedSegments[1], "~c");
+
+  uri_parser::Parser<const char*> parser;
+  EXPECT_EQ(parser.parse("/x/y/z").PathSegments()[2], "z");
+  EXPECT_EQ(parser.parse("/only").PathSegments().size(), 1u);
+}
+
+TEST(cppUriParser, path_view_iterator)
+{
+  auto entry = uri_parser::UriParseUrl("http://www.example.com/name%20with%20spaces/lalala/TheLastOne");
+
+  std::vector<std::string> segments;
+  for (auto segment : entry.Path())
+  {
+    segments.push_back(segment.to_string());
+  }
+  EXPECT_EQ(segments, (std::vector<std::string>{"name%20with%20spaces", "lalala", "TheLastOne"}));
+
+  auto path = entry.Path();
+  static_assert(std::is_trivially_copyable<decltype(path.begin())>::value, "path iterator must stay trivially copyable");
+  auto it = path.begin();
+  auto previous = it++;
+  EXPECT_EQ(*previous, "name%20with%20spaces");
+  EXPECT_EQ(it->size(), 6u);
+  EXPECT_EQ(std::distance(path.begin(), path.end()), 3);
+
+  const auto first = path.begin();
+  EXPECT_TRUE(first == path.begin());
+  EXPECT_TRUE(uri_parser::UriParseUrl("http://www.example.com").Path().empty());
+
+  // the string iterator's post-increment hands back the old position as well
+  auto pathHead = entry.PathHead();
+  auto headIt = std::begin(pathHead);
+  auto headPrevious = headIt++;
+  EXPECT_EQ(*headPrevious, "name%20with%20spaces");
+  EXPECT_EQ(*headIt, "lalala");
+}